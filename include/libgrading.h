@@ -21,6 +21,7 @@
 #ifndef LIBGRADING_H
 #define LIBGRADING_H
 
+#include <chrono>
 #include <functional>
 #include <iostream>
 #include <memory>
@@ -38,6 +39,14 @@ class Test;
 class TestBuilder;
 class TestSuite;
 
+struct Arguments;
+struct ChildLimits;
+class Formatter;
+class Journal;
+class ResultCache;
+class SharedMemory;
+class TestHistory;
+
 
 //! How a test finished executing.
 enum class TestExitStatus
@@ -48,22 +57,320 @@ enum class TestExitStatus
 	Segfault,            //!< the test caused a segmentation fault
 	Timeout,             //!< the test took too long to run
 	UncaughtException,   //!< the test threw an exception
-	OtherError           //!< the test terminated for another reason
+	OtherError,          //!< the test terminated for another reason
+	OutputLimit,         //!< the test wrote too much output
+	MemoryLimit,         //!< the test ran out of memory
+	CpuLimit,            //!< the test used too much CPU time
+	FileSizeLimit,       //!< the test tried to write too large a file
+	Skipped,             //!< the test wasn't run: a prerequisite failed
+};
+
+
+/**
+ * A read-only view of captured output (like C++17's std::string_view).
+ *
+ * An OutputView does not own the bytes it refers to: it is only valid for
+ * as long as the @ref TestResult that it came from.
+ */
+class OutputView
+{
+	public:
+	OutputView(const char *data, size_t size) : data_(data), size_(size) {}
+
+	const char* data() const { return data_; }
+	size_t size() const { return size_; }
+	bool empty() const { return size_ == 0; }
+
+	const char* begin() const { return data_; }
+	const char* end() const { return data_ + size_; }
+
+	//! Copy the viewed output into a new string.
+	std::string str() const { return std::string(data_, size_); }
+
+	private:
+	const char *data_;
+	size_t size_;
+};
+
+
+/**
+ * Hardware and software events counted while a test ran (see
+ * @ref TestBuilder::countEvents), or -1 for events that couldn't be counted
+ * (e.g., on a virtual machine without hardware performance counters).
+ *
+ * Events are counted in user mode, for the test's process and any processes
+ * that it creates. Unlike timings, instruction counts hardly vary from run
+ * to run, even on a busy machine.
+ *
+ * All of the events are counted together, as one group. If the group had to
+ * share the hardware with other counters (e.g., other tests' counters), it
+ * was only counting for part of the test's run: its counts are then scaled
+ * up to estimates of the whole run and flagged as @ref multiplexed.
+ */
+struct EventCounts
+{
+	EventCounts()
+		: instructions(-1), cycles(-1), cacheMisses(-1),
+		  branchMisses(-1), taskClock(-1), pageFaults(-1),
+		  multiplexed(false)
+	{
+	}
+
+	long long instructions;     //!< instructions retired
+	long long cycles;           //!< CPU cycles
+	long long cacheMisses;      //!< last-level cache misses
+	long long branchMisses;     //!< mispredicted branches
+	long long taskClock;        //!< CPU time (software counter) [ns]
+	long long pageFaults;       //!< page faults (software counter)
+
+	//! The counts are estimates, scaled up from part of the run.
+	bool multiplexed;
+};
+
+
+/**
+ * Resources consumed while running a test.
+ *
+ * Wall-clock time is measured against a monotonic clock; the rest comes
+ * from getrusage(2) or wait4(2). Tests run within the test suite's own
+ * process (or a batch of tests in one process) share a maximum RSS.
+ */
+struct ResourceUsage
+{
+	ResourceUsage()
+		: wallTime(0), userTime(0), systemTime(0), maxResidentKiB(0),
+		  minorFaults(0), majorFaults(0),
+		  voluntarySwitches(0), involuntarySwitches(0), strayProcesses(0)
+	{
+	}
+
+	std::chrono::microseconds wallTime;     //!< elapsed real time
+	std::chrono::microseconds userTime;     //!< CPU time in user mode
+	std::chrono::microseconds systemTime;   //!< CPU time in the kernel
+
+	long maxResidentKiB;        //!< peak resident set size [KiB]
+	long minorFaults;           //!< page faults serviced without I/O
+	long majorFaults;           //!< page faults that required I/O
+	long voluntarySwitches;     //!< context switches to wait for things
+	long involuntarySwitches;   //!< context switches due to preemption
+
+	/**
+	 * Processes left behind by the test (e.g., by fork(2) or popen(3))
+	 * that had to be killed once the test finished or timed out.
+	 */
+	long strayProcesses;
+
+	//! Performance counters (for tests that count events).
+	EventCounts events;
+};
+
+
+/**
+ * Statistics about a benchmark test's timed iterations
+ * (see @ref TestBuilder::benchmark).
+ *
+ * Iterations are timed in samples of many iterations each. Samples that
+ * are far from the median (more than three scaled MADs) are rejected as
+ * outliers before the median and MAD are calculated.
+ */
+struct BenchmarkStatistics
+{
+	BenchmarkStatistics()
+		: samples(0), iterations(0), outliers(0), median(0), mad(0),
+		  referenceMedian(0), ratio(0)
+	{
+	}
+
+	unsigned long samples;      //!< timed samples (0: not a benchmark)
+	unsigned long iterations;   //!< iterations timed in all samples
+	unsigned long outliers;     //!< samples rejected as outliers
+
+	std::chrono::nanoseconds median;    //!< median time per iteration
+	std::chrono::nanoseconds mad;       //!< median absolute deviation
+
+	//! Median time per iteration of the reference implementation.
+	std::chrono::nanoseconds referenceMedian;
+
+	//! How many times slower than the reference the test was.
+	double ratio;
+};
+
+
+/**
+ * Memory allocated by a test (see @ref TestBuilder::trackAllocations).
+ *
+ * Allocations are counted through the global `operator new` and
+ * `operator delete` (which standard containers use), only while the test's
+ * closure runs. Live, peak and leaked sizes are the sizes of the blocks
+ * that malloc(3) returned, which may be larger than what was requested.
+ *
+ * Memory allocated directly with malloc(3) and friends (e.g., by C code or
+ * C libraries) is not counted.
+ *
+ * To count allocations, a separate library (`grading-allocations`) replaces
+ * the global `operator new` and `operator delete` (in all of their forms).
+ * Only test programs that track allocations should link it (as well as
+ * libgrading): outside of tracked tests, its operators simply call
+ * malloc(3) and free(3), but programs that don't link it keep their
+ * standard library's. Tests that track allocations in a program without it
+ * exit with @ref TestExitStatus::OtherError.
+ */
+struct AllocationStatistics
+{
+	AllocationStatistics()
+		: tracked(false), allocations(0), deallocations(0), bytes(0),
+		  peakBytes(0), leakedBlocks(0), leakedBytes(0)
+	{
+	}
+
+	bool tracked;                   //!< were allocations tracked?
+	unsigned long allocations;      //!< calls to operator new
+	unsigned long deallocations;    //!< calls to operator delete
+	size_t bytes;                   //!< total memory requested [B]
+	size_t peakBytes;               //!< most memory live at once [B]
+	unsigned long leakedBlocks;     //!< blocks never deleted
+	size_t leakedBytes;             //!< memory never deleted [B]
+};
+
+
+//! Complexity classes that we can fit to a test's running times.
+enum class Complexity
+{
+	Constant,            //!< O(1)
+	Logarithmic,         //!< O(log n)
+	Linear,              //!< O(n)
+	Linearithmic,        //!< O(n log n)
+	Quadratic,           //!< O(n^2)
+	Cubic,               //!< O(n^3)
+};
+
+
+//! What a complexity test measures at each input size.
+enum class ComplexityMetric
+{
+	Time,                //!< wall-clock time
+	Instructions,        //!< instructions retired (see @ref EventCounts)
+};
+
+
+/**
+ * Costs of a complexity test at growing input sizes, and the complexity
+ * class that best fits them (see @ref TestBuilder::complexity).
+ *
+ * Each class is fitted as `cost = intercept + coefficient * f(n)` by least
+ * squares (with a non-negative intercept), so fixed overheads don't distort
+ * the growth; the simplest class whose error is close to the smallest error
+ * is chosen.
+ */
+struct ComplexityStatistics
+{
+	ComplexityStatistics()
+		: expected(Complexity::Constant), fitted(Complexity::Constant),
+		  metric(ComplexityMetric::Time), intercept(0), coefficient(0),
+		  error(0)
+	{
+	}
+
+	std::vector<size_t> sizes;              //!< input sizes (empty: none)
+	std::vector<std::chrono::nanoseconds> times;    //!< median times
+
+	//! Instructions at each size (empty unless they were counted).
+	std::vector<long long> instructions;
+
+	Complexity expected;    //!< the worst acceptable complexity
+	Complexity fitted;      //!< the best-fitting complexity
+
+	//! The cost that was fitted (times, if instructions weren't counted).
+	ComplexityMetric metric;
+
+	double intercept;       //!< of the fitted model [ns or instructions]
+	double coefficient;     //!< of the fitted model [ns or instructions]
+
+	//! Root-mean-square error of the fit, relative to the mean cost.
+	double error;
 };
 
 
-//! The result of running one test.
+/**
+ * The result of running one test.
+ *
+ * A TestResult owns the buffers that a test's output was captured into.
+ * Copies of a TestResult share these buffers rather than copying them:
+ * @ref output and @ref errorOutput refer to the shared text, which
+ * @ref outputView and @ref errorOutputView also expose without copying.
+ */
 struct TestResult
 {
+	private:
+	// Declared (so initialized) first: output and errorOutput refer to them.
+	std::shared_ptr<const std::string> output_;
+	std::shared_ptr<const std::string> errorOutput_;
+
+	public:
 	//! Constructor: requires an exit status at minimum.
-	TestResult(TestExitStatus s, std::string out = "", std::string err = "")
-		: status(s), output(std::move(out)), errorOutput(std::move(err))
+	TestResult(TestExitStatus s, std::string out = "", std::string err = "",
+	           ResourceUsage u = ResourceUsage(),
+	           BenchmarkStatistics b = BenchmarkStatistics(),
+	           AllocationStatistics a = AllocationStatistics(),
+	           ComplexityStatistics c = ComplexityStatistics())
+		: output_(std::make_shared<const std::string>(std::move(out))),
+		  errorOutput_(std::make_shared<const std::string>(std::move(err))),
+		  status(s), usage(u), benchmark(b), allocations(a), complexity(c),
+		  output(*output_), errorOutput(*errorOutput_)
+	{
+	}
+
+	//! Copy a result, replacing its status but sharing its output.
+	TestResult(TestExitStatus s, const TestResult &other)
+		: output_(other.output_), errorOutput_(other.errorOutput_),
+		  status(s), usage(other.usage), benchmark(other.benchmark),
+		  allocations(other.allocations), complexity(other.complexity),
+		  output(*output_), errorOutput(*errorOutput_)
+	{
+	}
+
+	//! Copy a result, adding benchmark statistics.
+	TestResult(const TestResult &other, BenchmarkStatistics b)
+		: output_(other.output_), errorOutput_(other.errorOutput_),
+		  status(other.status), usage(other.usage), benchmark(b),
+		  allocations(other.allocations), complexity(other.complexity),
+		  output(*output_), errorOutput(*errorOutput_)
+	{
+	}
+
+	//! Copy a result, adding the statistics that its test recorded.
+	TestResult(const TestResult &other, BenchmarkStatistics b,
+	           AllocationStatistics a, ComplexityStatistics c)
+		: output_(other.output_), errorOutput_(other.errorOutput_),
+		  status(other.status), usage(other.usage), benchmark(b),
+		  allocations(a), complexity(c),
+		  output(*output_), errorOutput(*errorOutput_)
 	{
 	}
 
 	const TestExitStatus status;     //!< how the test ended
-	const std::string output;        //!< stdout from test execution
-	const std::string errorOutput;   //!< stderr from test execution
+	const ResourceUsage usage;       //!< resources used by the test
+	const BenchmarkStatistics benchmark;    //!< for benchmark tests only
+	const AllocationStatistics allocations; //!< if allocations are tracked
+	const ComplexityStatistics complexity;  //!< for complexity tests only
+
+	//! stdout from test execution (truncated, with a marker, if too long)
+	const std::string &output;
+
+	//! stderr from test execution (truncated, with a marker, if too long)
+	const std::string &errorOutput;
+
+	//! View @ref output without copying it.
+	OutputView outputView() const
+	{
+		return OutputView(output.data(), output.size());
+	}
+
+	//! View @ref errorOutput without copying it.
+	OutputView errorOutputView() const
+	{
+		return OutputView(errorOutput.data(), errorOutput.size());
+	}
 };
 
 
@@ -71,13 +378,15 @@ struct TestResult
  * Ways that we can run tests.
  *
  * We can select among these at run-time with the command-line argument
- * `--strategy=inline|separated|sandboxed`.
+ * `--strategy=inline|separated|sandboxed|forkserver|batched`.
  */
 enum class TestRunStrategy
 {
 	Inline,      //!< In the same process, in the current call stack.
 	Separated,   //!< In separate but unsandboxed processes.
 	Sandboxed,   //!< In a separate, sandboxed process (if supported).
+	ForkServer,  //!< In sandboxed children of a pre-forked server process.
+	Batched,     //!< Many tests per sandboxed process, replaced on failure.
 };
 
 
@@ -123,17 +432,75 @@ class TestSuite
 		unsigned int failed;    //!< tests that failed (unweighted)
 		float score;            //!< weighted (passed/total) score
 		unsigned int total;     //!< total test count (unweighted)
+		unsigned int skipped;   //!< failed tests that were never run
+		unsigned int cacheHits;     //!< results served from `--cache`
+		unsigned int cacheMisses;   //!< tests run for lack of a cached result
+
+		/**
+		 * CPU time used by the test suite's own process to start,
+		 * supervise and report tests (zero for inline tests, which
+		 * can't be told apart from it).
+		 */
+		std::chrono::microseconds supervisionTime;
 	};
 
 	/**
 	 * Run all tests, using command-line arguments to guide the
 	 * testing strategy, timeouts, etc.
 	 *
+	 * Tests run after their prerequisites (see @ref TestBuilder::after).
+	 * If a prerequisite doesn't pass, the tests that depend on it are
+	 * reported as @ref TestExitStatus::Skipped without being run.
+	 *
+	 * With `--cache=DIR`, results are saved in (and served from) an
+	 * on-disk cache, keyed by the test executable's contents (or by
+	 * `--submission=ID`) and each test's name and limits. Tests should
+	 * have distinct names (or descriptions) for caching to be reliable.
+	 *
+	 * With `--journal=FILE`, each result is appended to a journal as soon
+	 * as its test finishes. After an interruption, `--resume` reports the
+	 * journalled results and only runs the tests that are missing.
+	 *
+	 * With `--history=FILE`, tests' durations are remembered from run to
+	 * run, and concurrent runs start the longest tests (or chains of
+	 * prerequisites) first. Results are still reported in suite order.
+	 * `--suite-order` starts tests in suite order instead.
+	 *
+	 * With `--calibrate=FILE`, the suite is run several times (e.g.,
+	 * against a reference solution) without tests' own timeouts, and a
+	 * profile of timeouts based on each test's 95th-percentile duration
+	 * is written to FILE. Only the last run is reported.
+	 * `--timeout-profile=FILE` applies such a profile in place of tests'
+	 * own timeouts (but `--timeout` still limits every test).
+	 *
+	 * `--count-events` counts events (see @ref EventCounts) in every
+	 * test, as if each had been built with @ref TestBuilder::countEvents.
+	 * Similarly, `--profile` profiles every test (see
+	 * @ref TestBuilder::profile).
+	 *
+	 * With `--shard=i/N`, only the i-th of N balanced subsets of the
+	 * tests is run. Shards' `--format=results` outputs can be combined
+	 * with `--merge`, which reports them as if they had been run at once.
+	 *
 	 * @returns  summary statistics about the suite run
 	 */
 	Statistics Run(int argc, char *argv[]) const;
 
 	private:
+	//! Report the results that shards have saved, rather than running.
+	void MergeResults(const std::vector<Test>&, const Arguments&,
+	                  Formatter&, Statistics&) const;
+
+	//! Run tests one at a time, in suite order.
+	void RunSerially(const std::vector<Test>&, const Arguments&,
+	                 ResultCache*, Journal*, TestHistory*, Formatter&,
+	                 Statistics&) const;
+
+	//! Run tests in several child processes at once.
+	void RunConcurrently(const std::vector<Test>&, const Arguments&,
+	                     ResultCache*, Journal*, TestHistory*, Formatter&,
+	                     Statistics&) const;
+
 	std::vector<Test> tests_;
 };
 
@@ -141,12 +508,54 @@ class TestSuite
 //! A closure that wraps a single test case.
 typedef std::function<void ()> TestClosure;
 
+//! A closure that runs code on an input of a given size.
+typedef std::function<void (size_t)> SizedClosure;
+
+
+/**
+ * How long a test may run before it is killed (zero means "run forever").
+ *
+ * Timeouts are measured against a monotonic clock with millisecond accuracy.
+ * Wherever a timeout can be given as a `time_t`, it is interpreted as a
+ * number of seconds.
+ */
+typedef std::chrono::milliseconds Timeout;
+
+
+/**
+ * Limits on the operating system resources that a test may use.
+ *
+ * These limits are applied with setrlimit(2) in the process that runs a
+ * test, so they have no effect on tests run inline. Zero means "no limit"
+ * or, for a single test, "use the test suite's limit".
+ */
+struct ResourceLimits
+{
+	ResourceLimits()
+		: memory(0), cpuTime(0), fileSize(0), processes(0)
+	{
+	}
+
+	size_t memory;                  //!< address space and data [B]
+	std::chrono::seconds cpuTime;   //!< user plus system CPU time
+	size_t fileSize;                //!< largest file the test may write [B]
+
+	/**
+	 * Number of processes (and threads) that may be running.
+	 *
+	 * The operating system counts all of the processes that belong to
+	 * the user running the tests, not just the test's children.
+	 */
+	unsigned int processes;
+};
+
 
 /**
  * A set of arbitrary tags that can describe tests.
  *
- * Tag-informed test running isn't implemented yet, but we will soon
- * be able to output tags to, e.g., Gradescope output.
+ * Tags are included in Gradescope output and can be used to choose which
+ * tests to run (`--tags` and `--exclude-tags`) or to declare prerequisites
+ * (@ref TestBuilder::afterTag).
  */
 typedef std::unordered_set<std::string> TagSet;
 
@@ -175,9 +584,147 @@ class TestBuilder
 	//! Add test details.
 	TestBuilder& test(TestClosure);
 
-	//! Set the test timeout (0 means "run forever").
+	//! Set the test timeout in seconds (0 means "run forever").
 	TestBuilder& timeout(time_t);
 
+	//! Set the test timeout (zero means "run forever").
+	TestBuilder& timeout(Timeout);
+
+	/**
+	 * Set the maximum amount of output (stdout plus stderr, in bytes)
+	 * that the test may write before it is killed.
+	 *
+	 * Zero means "use the test suite's limit".
+	 */
+	TestBuilder& outputLimit(size_t);
+
+	//! Limit the memory that the test may allocate [B].
+	TestBuilder& memoryLimit(size_t);
+
+	//! Limit the CPU time that the test may use.
+	TestBuilder& cpuLimit(std::chrono::seconds);
+
+	//! Limit the size of files that the test may write [B].
+	TestBuilder& fileSizeLimit(size_t);
+
+	//! Limit the number of processes that may be running during the test.
+	TestBuilder& processLimit(unsigned int);
+
+	/**
+	 * Run the test in an empty working directory of its own.
+	 *
+	 * The directory is memory-backed where possible (tmpfs) and is
+	 * deleted after the test finishes. Inline tests share the test
+	 * suite's working directory.
+	 */
+	TestBuilder& scratchDirectory(bool = true);
+
+	/**
+	 * Count hardware and software events (e.g., instructions retired)
+	 * while the test runs: see @ref EventCounts.
+	 *
+	 * Events can only be counted in tests that run in processes of
+	 * their own (i.e., not inline or batched), on platforms that
+	 * support it (currently Linux, via perf_event_open(2)).
+	 */
+	TestBuilder& countEvents(bool = true);
+
+	/**
+	 * Sample the test's stack (with `SIGPROF`, every millisecond of CPU
+	 * time) while it runs. If the test times out or exceeds its CPU time
+	 * limit, the functions it spent the most time in are reported after
+	 * its error output.
+	 *
+	 * Like event counting, this only works for tests that run in
+	 * processes of their own. Functions in the test program itself are
+	 * only named if it exports its symbols (e.g., with `-rdynamic`);
+	 * otherwise, they are reported as offsets within the program.
+	 */
+	TestBuilder& profile(bool = true);
+
+	/**
+	 * Track the memory that the test allocates with `new` (see
+	 * @ref AllocationStatistics), reporting it in
+	 * @ref TestResult::allocations.
+	 *
+	 * This is much cheaper than running the test under a tool such as
+	 * valgrind, but it only sees C++ allocations: memory that C code
+	 * allocates with malloc(3) isn't counted. The test program must also
+	 * link the `grading-allocations` library.
+	 */
+	TestBuilder& trackAllocations(bool = true);
+
+	//! Fail the test if it makes more than this many allocations.
+	TestBuilder& maxAllocations(unsigned long);
+
+	//! Fail the test if it has more than this much memory live at once.
+	TestBuilder& maxAllocatedBytes(size_t bytes);
+
+	//! Fail the test if it doesn't delete everything that it allocates.
+	TestBuilder& forbidLeaks(bool = true);
+
+	/**
+	 * Only run the test after another test (or every test with a given
+	 * tag) has passed.
+	 *
+	 * If any prerequisite fails, this test is skipped rather than run.
+	 * Prerequisites that don't match any test being run (e.g., tests that
+	 * were filtered out with `--tags`) are ignored.
+	 */
+	TestBuilder& after(std::string testName);
+
+	//! Only run the test after every test with the given tag has passed.
+	TestBuilder& afterTag(std::string tag);
+
+	/**
+	 * Make this a benchmark that grades efficiency as well as correctness.
+	 *
+	 * After the test's own closure (if any) checks correctness, the
+	 * benchmarked code is run repeatedly in the test's process: first to
+	 * warm up, then in timed samples that alternate with samples of a
+	 * reference implementation. The test fails if the median time per
+	 * iteration is more than @a maxRatio times the reference's. Its
+	 * statistics are reported in @ref TestResult::benchmark.
+	 *
+	 * @param   code         one iteration of the code being graded
+	 * @param   reference    one iteration of a reference implementation
+	 * @param   maxRatio     how many times slower than the reference
+	 *                       the code may be
+	 * @param   samples      how many timed samples to take of each
+	 */
+	TestBuilder& benchmark(TestClosure code, TestClosure reference,
+	                       double maxRatio = 2, unsigned int samples = 15);
+
+	/**
+	 * Make this a test of how code's running time grows with the size
+	 * of its input (e.g., to tell an O(n log n) sort from an O(n^2) one).
+	 *
+	 * After the test's own closure (if any) checks correctness, @a code
+	 * is measured at each size in turn, each in a process of its own
+	 * (forked from the test's) so that one size's heap and caches don't
+	 * affect the next. Times are the median of several samples, each of
+	 * which may call @a code many times. The test fails if the complexity
+	 * class that best fits these costs grows faster than @a expected.
+	 * The measurements and the fit are reported in
+	 * @ref TestResult::complexity.
+	 *
+	 * Instruction counts hardly vary from run to run, even on a busy
+	 * machine, but not every system can count them (e.g., virtual machines
+	 * often can't): where they can't be counted, times are fitted instead.
+	 *
+	 * @param   code         run the code being graded on an input of
+	 *                       size n (doing the same work every time, e.g.,
+	 *                       by copying an input generated in advance)
+	 * @param   sizes        input sizes to measure (at least three,
+	 *                       spanning orders of magnitude); sizes of 0
+	 *                       are ignored
+	 * @param   expected     the worst acceptable complexity class
+	 * @param   metric       what to measure and fit at each size
+	 */
+	TestBuilder& complexity(SizedClosure code, std::vector<size_t> sizes,
+	                        Complexity expected,
+	                        ComplexityMetric metric = ComplexityMetric::Time);
+
 	/**
 	 * Set the weight accorded to a test.
 	 *
@@ -192,9 +739,28 @@ class TestBuilder
 	const std::string name_;
 	std::string description_;
 	TestClosure test_;
-	time_t timeout_;
+	Timeout timeout_;
 	unsigned int weight_;
 	TagSet tags_;
+	size_t outputLimit_;
+	ResourceLimits resourceLimits_;
+	bool scratchDirectory_;
+	bool countEvents_;
+	bool profile_;
+	bool trackAllocations_;
+	unsigned long maxAllocations_;
+	size_t maxAllocatedBytes_;
+	bool forbidLeaks_;
+	std::vector<std::string> prerequisites_;
+	TagSet prerequisiteTags_;
+	TestClosure benchmark_;
+	TestClosure reference_;
+	double maxRatio_;
+	unsigned int samples_;
+	SizedClosure complexity_;
+	std::vector<size_t> complexitySizes_;
+	Complexity expectedComplexity_;
+	ComplexityMetric complexityMetric_;
 };
 
 
@@ -214,6 +780,11 @@ class Test
 	     time_t timeout = 0, unsigned int weight = 1,
 	     TagSet tags = TagSet());
 
+	//! Standard constructor with a std::chrono timeout.
+	Test(std::string name, std::string description, TestClosure,
+	     Timeout timeout, unsigned int weight = 1,
+	     TagSet tags = TagSet());
+
 	/**
 	 * Function-plus-expectation constructor.
 	 *
@@ -230,6 +801,15 @@ class Test
 	{
 	}
 
+	//! Function-plus-expectation constructor with a std::chrono timeout.
+	template<class Expectation>
+	Test(std::string name, std::string description,
+	     std::function<void (const Expectation&)> fn,
+	     Expectation e, Timeout timeout, unsigned int weight = 1)
+		: Test(name, description, std::bind(fn, e), timeout, weight)
+	{
+	}
+
 	/**
 	 * Function-pointer constructor.
 	 *
@@ -246,6 +826,15 @@ class Test
 	{
 	}
 
+	//! Function-pointer constructor with a std::chrono timeout.
+	template<class Expectation>
+	Test(std::string name, std::string description,
+	     void (*fn)(const Expectation&),
+	     Expectation e, Timeout timeout, unsigned int weight = 1)
+		: Test(name, description, std::bind(fn, e), timeout, weight)
+	{
+	}
+
 	//! User-meaningful test name (ideally a single line or less).
 	std::string name() const { return name_; }
 
@@ -253,32 +842,114 @@ class Test
 	std::string description() const { return description_; }
 
 	//! User-defined tags on this test.
-	TagSet tags() const { return tags_; }
+	const TagSet& tags() const { return tags_; }
+
+	/**
+	 * Maximum length of time this test should take, in whole seconds
+	 * (or 0 for unlimited). Sub-second timeouts are rounded up.
+	 */
+	time_t timeout() const
+	{
+		using std::chrono::seconds;
+
+		const seconds s = std::chrono::duration_cast<seconds>(timeout_);
+		return static_cast<time_t>((s < timeout_) ? s.count() + 1
+		                                           : s.count());
+	}
 
 	//! Maximum length of time this test should take (or 0 for unlimited).
-	time_t timeout() const { return timeout_; }
+	Timeout timeoutDuration() const { return timeout_; }
 
 	//! How much weight to place on this test when calculating final score.
 	unsigned int weight() const { return weight_; }
 
+	//! Maximum output this test may write [B] (or 0 for the suite default).
+	size_t outputLimit() const { return outputLimit_; }
+
+	//! Operating system resource limits for this test.
+	ResourceLimits resourceLimits() const { return resourceLimits_; }
+
+	//! Does this test run in a scratch directory of its own?
+	bool scratchDirectory() const { return scratchDirectory_; }
+
+	//! Does this test count hardware and software events?
+	bool countEvents() const { return countEvents_; }
+
+	//! Does this test sample its stacks (see @ref TestBuilder::profile)?
+	bool profile() const { return profile_; }
+
+	//! This test's position within its @ref TestSuite.
+	size_t index() const { return index_; }
+
+	//! Names of tests that must pass before this one runs.
+	std::vector<std::string> prerequisites() const
+	{
+		return prerequisites_;
+	}
+
+	//! Tags of tests that must pass before this one runs.
+	TagSet prerequisiteTags() const { return prerequisiteTags_; }
+
 	/**
 	 * Run this test.
 	 *
 	 * @param  strategy     how to run the test (e.g., sandboxed)
-	 * @param  timeout      how long to wait for completion (0 = forever)
+	 * @param  timeout      how long to wait for completion [s] (0 = forever)
 	 */
 	TestResult Run(TestRunStrategy strategy, time_t timeout = 0) const;
 
+	/**
+	 * Run this test.
+	 *
+	 * @param  strategy     how to run the test (e.g., sandboxed)
+	 * @param  timeout      how long to wait for completion (0 = forever)
+	 */
+	TestResult Run(TestRunStrategy strategy, Timeout timeout) const;
+
 
 	private:
+	//! The closure to run when using a given @ref TestRunStrategy.
+	TestClosure closure(TestRunStrategy) const;
+
+	//! This test's limits, constrained by suite-wide limits.
+	ChildLimits limits(const ChildLimits &suiteLimits) const;
+
+	//! Forget any statistics recorded by an earlier run.
+	void clearStatistics() const;
+
+	/**
+	 * Add the statistics that the test recorded (if it is a benchmark
+	 * or complexity test, or tracks its allocations) to its result.
+	 */
+	TestResult withStatistics(const TestResult&) const;
+
 	const std::string name_;
 	const std::string description_;
 	const TestClosure test_;
-	const time_t timeout_;
+	Timeout timeout_;
 	const unsigned int weight_;
 	const TagSet tags_;
 
+	size_t outputLimit_;
+	ResourceLimits resourceLimits_;
+	bool scratchDirectory_;
+	bool countEvents_;
+	bool profile_;
+	std::vector<std::string> prerequisites_;
+	TagSet prerequisiteTags_;
+	size_t index_;
+
+	//! Where a benchmark test records its statistics (if it is one).
+	std::shared_ptr<SharedMemory> benchmark_;
+
+	//! Where a test that tracks its allocations counts them.
+	std::shared_ptr<SharedMemory> allocations_;
+
+	//! Where a complexity test records its measurements (if it is one).
+	std::shared_ptr<SharedMemory> complexity_;
+
 	friend class TestBuilder;
+	friend class TestSuite;
 };
 
 
@@ -393,6 +1064,12 @@ CheckResult Fail(std::string message);
 //! Output a human-readable representation of a @ref TestExitStatus.
 std::ostream& operator << (std::ostream&, TestExitStatus);
 
+//! Output a complexity class in big-O notation (e.g., "O(n log n)").
+std::ostream& operator << (std::ostream&, Complexity);
+
+//! Write the bytes of an @ref OutputView (without copying them).
+std::ostream& operator << (std::ostream&, OutputView);
+
 } // namespace grading
 
 #endif
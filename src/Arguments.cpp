@@ -22,6 +22,12 @@
 
 #include <optionparser.h>
 
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <thread>
 #include <vector>
 
 using namespace grading;
@@ -37,6 +43,32 @@ enum Options
 	SKIP_TESTS,
 	RUN_STRATEGY,
 	TIMEOUT,
+	JOBS,
+	OUTPUT_LIMIT,
+	OUTPUT_HEAD,
+	OUTPUT_TAIL,
+	MEMORY_LIMIT,
+	CPU_LIMIT,
+	FILE_SIZE_LIMIT,
+	PROCESS_LIMIT,
+	CORE_DUMPS,
+	SCRATCH,
+	COUNT_EVENTS,
+	PROFILE,
+	NAME,
+	TAGS,
+	EXCLUDE_TAGS,
+	SHARD,
+	MERGE,
+	CACHE,
+	SUBMISSION,
+	JOURNAL,
+	RESUME,
+	HISTORY,
+	SUITE_ORDER,
+	CALIBRATE,
+	CALIBRATION_RUNS,
+	TIMEOUT_PROFILE,
 };
 
 //! Check that a required argument has been passed.
@@ -51,6 +83,98 @@ static option::ArgStatus Required(const option::Option& option, bool msg)
 	return option::ARG_ILLEGAL;
 }
 
+/**
+ * Parse a timeout such as `5`, `5s`, `1.5s`, `250ms` or `2m`.
+ *
+ * A number without units is interpreted as seconds, as in earlier versions.
+ */
+static bool ParseTimeout(const std::string &arg, Timeout &timeout)
+{
+	char *end;
+	const double value = std::strtod(arg.c_str(), &end);
+	const std::string unit = end;
+
+	if (end == arg.c_str() or not std::isfinite(value) or value < 0)
+		return false;
+
+	double ms;
+	if (unit == "ms")
+		ms = value;
+
+	else if (unit.empty() or unit == "s")
+		ms = value * 1000;
+
+	else if (unit == "m")
+		ms = value * 60 * 1000;
+
+	else
+		return false;
+
+	// Deadlines are computed on the monotonic clock: they mustn't overflow.
+	const Timeout longest = std::chrono::duration_cast<Timeout>(
+		std::chrono::steady_clock::duration::max()) / 2;
+
+	if (std::ceil(ms) > static_cast<double>(longest.count()))
+		return false;
+
+	timeout = Timeout(static_cast<Timeout::rep>(std::ceil(ms)));
+	return true;
+}
+
+//! Append the non-empty elements of a comma-separated list to a vector.
+static void SplitList(const std::string &arg, vector<std::string> &values)
+{
+	size_t start = 0;
+	while (start <= arg.size())
+	{
+		size_t end = arg.find(',', start);
+		if (end == std::string::npos)
+			end = arg.size();
+
+		if (end > start)
+			values.push_back(arg.substr(start, end - start));
+
+		start = end + 1;
+	}
+}
+
+/**
+ * Parse a size such as `4096`, `32K`, `16M` or `1G` (in bytes).
+ */
+static bool ParseSize(const std::string &arg, size_t &size)
+{
+	char *end;
+	errno = 0;
+	const unsigned long long value = std::strtoull(arg.c_str(), &end, 10);
+	const std::string unit = end;
+
+	if (end == arg.c_str() or arg[0] == '-' or errno == ERANGE)
+		return false;
+
+	unsigned int shift;
+	if (unit.empty())
+		shift = 0;
+
+	else if (unit == "K" or unit == "k")
+		shift = 10;
+
+	else if (unit == "M")
+		shift = 20;
+
+	else if (unit == "G")
+		shift = 30;
+
+	else
+		return false;
+
+	// Don't let a huge limit wrap around to a small one.
+	if (value > (std::numeric_limits<size_t>::max() >> shift))
+		return false;
+
+	size = static_cast<size_t>(value) << shift;
+	return true;
+}
+
 //! Usage strings for command-line arguments.
 const option::Descriptor usage[] =
 {
@@ -70,7 +194,7 @@ const option::Descriptor usage[] =
 		"f", "format",
 		Required,
 		"  -f, --format        Output format"
-		" (brief, gradescope, verbose)."
+		" (brief, gradescope, verbose, results)."
 	},
 	{
 		SKIP_TESTS, 0,
@@ -83,13 +207,193 @@ const option::Descriptor usage[] =
 		"r", "run-strategy",
 		Required,
 		"  -r, --run-strategy  Strategy for running tests"
-		" (inline, separated, sandboxed)."
+		" (inline, separated, sandboxed, forkserver, batched)."
 	},
 	{
 		TIMEOUT, 0,
 		"t", "timeout",
 		Required,
-		"  -t, --timeout       Kill tests after n seconds."
+		"  -t, --timeout       Kill tests after a time limit"
+		" (e.g., 5, 5s, 250ms, 2m)."
+	},
+	{
+		JOBS, 0,
+		"j", "jobs",
+		Required,
+		"  -j, --jobs          Run up to n tests at once"
+		" (0: one per CPU)."
+	},
+	{
+		OUTPUT_LIMIT, 0,
+		"", "output-limit",
+		Required,
+		"      --output-limit  Kill tests that write more output than this"
+		" (e.g., 64K, 16M; 0: no limit)."
+	},
+	{
+		OUTPUT_HEAD, 0,
+		"", "output-head",
+		Required,
+		"      --output-head   Bytes of each output stream to keep"
+		" from the start."
+	},
+	{
+		OUTPUT_TAIL, 0,
+		"", "output-tail",
+		Required,
+		"      --output-tail   Bytes of each output stream to keep"
+		" from the end."
+	},
+	{
+		MEMORY_LIMIT, 0,
+		"", "memory-limit",
+		Required,
+		"      --memory-limit  Limit the memory each test may allocate"
+		" (e.g., 256M)."
+	},
+	{
+		CPU_LIMIT, 0,
+		"", "cpu-limit",
+		Required,
+		"      --cpu-limit     Limit the CPU time each test may use"
+		" (e.g., 10s, 2m)."
+	},
+	{
+		FILE_SIZE_LIMIT, 0,
+		"", "file-size-limit",
+		Required,
+		"      --file-size-limit  Limit the size of files that tests"
+		" may write (e.g., 1M)."
+	},
+	{
+		PROCESS_LIMIT, 0,
+		"", "process-limit",
+		Required,
+		"      --process-limit  Limit the number of processes that may"
+		" be running (for the whole user)."
+	},
+	{
+		CORE_DUMPS, 0,
+		"", "core-dumps",
+		option::Arg::None,
+		"      --core-dumps    Allow crashing tests to write core files."
+	},
+	{
+		SCRATCH, 0,
+		"", "scratch",
+		option::Arg::None,
+		"      --scratch       Run each test in an empty scratch directory."
+	},
+	{
+		COUNT_EVENTS, 0,
+		"", "count-events",
+		option::Arg::None,
+		"      --count-events  Count instructions, cycles, etc."
+		" while each test runs."
+	},
+	{
+		PROFILE, 0,
+		"", "profile",
+		option::Arg::None,
+		"      --profile       Sample tests' stacks, reporting the hottest"
+		" functions of tests that time out."
+	},
+	{
+		NAME, 0,
+		"n", "name",
+		Required,
+		"  -n, --name          Only run tests whose names match a pattern"
+		" (e.g., 'list*')."
+	},
+	{
+		TAGS, 0,
+		"", "tags",
+		Required,
+		"      --tags          Only run tests with any of these tags"
+		" (comma-separated)."
+	},
+	{
+		EXCLUDE_TAGS, 0,
+		"", "exclude-tags",
+		Required,
+		"      --exclude-tags  Don't run tests with any of these tags."
+	},
+	{
+		SHARD, 0,
+		"", "shard",
+		Required,
+		"      --shard         Only run shard i of N (e.g., 2/4),"
+		" balanced by test weight."
+	},
+	{
+		MERGE, 0,
+		"", "merge",
+		Required,
+		"      --merge         Report results saved by shards"
+		" (with --format=results) instead of running tests."
+	},
+	{
+		CACHE, 0,
+		"", "cache",
+		Required,
+		"      --cache         Reuse results saved in this directory"
+		" (and save new ones there)."
+	},
+	{
+		SUBMISSION, 0,
+		"", "submission",
+		Required,
+		"      --submission    Identify the code under test for --cache"
+		" and --journal (default: hash the test executable)."
+	},
+	{
+		JOURNAL, 0,
+		"", "journal",
+		Required,
+		"      --journal       Record each result in this file"
+		" as soon as its test finishes."
+	},
+	{
+		RESUME, 0,
+		"", "resume",
+		option::Arg::None,
+		"      --resume        Only run tests that aren't in the --journal"
+		" yet."
+	},
+	{
+		HISTORY, 0,
+		"", "history",
+		Required,
+		"      --history       Remember tests' durations in this file"
+		" and start the longest tests first."
+	},
+	{
+		SUITE_ORDER, 0,
+		"", "suite-order",
+		option::Arg::None,
+		"      --suite-order   Start tests in suite order, even with"
+		" a --history."
+	},
+	{
+		CALIBRATE, 0,
+		"", "calibrate",
+		Required,
+		"      --calibrate     Run the suite several times and write"
+		" a profile of timeouts to this file."
+	},
+	{
+		CALIBRATION_RUNS, 0,
+		"", "calibration-runs",
+		Required,
+		"      --calibration-runs  How many times to run the suite"
+		" for --calibrate (default: 5)."
+	},
+	{
+		TIMEOUT_PROFILE, 0,
+		"", "timeout-profile",
+		Required,
+		"      --timeout-profile  Use the timeouts in a --calibrate profile"
+		" instead of tests' own."
 	},
 	{0,0,0,0,0,0}
 };
@@ -135,11 +439,15 @@ Arguments Arguments::Parse(int argc, char *argv[])
 		{
 			format = OutputFormat::Verbose;
 		}
+		else if (arg == "results")
+		{
+			format = OutputFormat::Results;
+		}
 		else
 		{
 			std::cerr
 				<< "Invalid --format: '" << arg << "'\n"
-				"Valid options: brief, gradescope, verbose\n"
+				"Valid options: brief, gradescope, verbose, results\n"
 				;
 
 			return Arguments();
@@ -163,39 +471,297 @@ Arguments Arguments::Parse(int argc, char *argv[])
 		{
 			strategy = TestRunStrategy::Sandboxed;
 		}
+		else if (strategyArg == "forkserver")
+		{
+			strategy = TestRunStrategy::ForkServer;
+		}
+		else if (strategyArg == "batched")
+		{
+			strategy = TestRunStrategy::Batched;
+		}
 		else
 		{
 			std::cerr
 				<< "Invalid --strategy: '" << strategyArg << "'"
 				"\n(valid strategies: "
-				"inline, separated, sandboxed)\n"
+				"inline, separated, sandboxed, forkserver, "
+				"batched)\n"
 				;
 
 			return Arguments();
 		}
 	}
 
-	time_t timeout = 0;
+	// Inline tests write to the same stdout that results would go to.
+	if (format == OutputFormat::Results
+	    and strategy == TestRunStrategy::Inline and not options[MERGE])
+	{
+		std::cerr
+			<< "--format=results can't be used with"
+			" --run-strategy=inline: tests' output would be"
+			" mixed into the results\n";
+
+		return Arguments();
+	}
+
+	ChildLimits limits;
 	if (options[TIMEOUT])
 	{
 		const std::string arg = options[TIMEOUT].arg;
-		timeout = std::atol(arg.c_str());
+
+		if (not ParseTimeout(arg, limits.timeout))
+		{
+			std::cerr
+				<< "Invalid --timeout: '" << arg << "'\n"
+				"(expected a time such as 5, 5s, 250ms or 2m)\n"
+				;
+
+			return Arguments();
+		}
+	}
+
+	if (options[CPU_LIMIT])
+	{
+		const std::string arg = options[CPU_LIMIT].arg;
+
+		Timeout t;
+		if (not ParseTimeout(arg, t))
+		{
+			std::cerr
+				<< "Invalid --cpu-limit: '" << arg << "'\n"
+				"(expected a time such as 5, 5s or 2m)\n"
+				;
+
+			return Arguments();
+		}
+
+		// RLIMIT_CPU has a granularity of seconds: round up.
+		limits.resources.cpuTime = std::chrono::seconds(
+			(t.count() + 999) / 1000);
+	}
+
+	if (options[PROCESS_LIMIT])
+	{
+		const std::string arg = options[PROCESS_LIMIT].arg;
+
+		char *end;
+		const long n = std::strtol(arg.c_str(), &end, 10);
+
+		if (arg.empty() or *end != '\0' or n < 0)
+		{
+			std::cerr
+				<< "Invalid --process-limit: '" << arg << "'\n"
+				"(expected a non-negative integer)\n"
+				;
+
+			return Arguments();
+		}
+
+		limits.resources.processes = static_cast<unsigned int>(n);
+	}
+
+	limits.coreDumps = options[CORE_DUMPS];
+	limits.scratchDirectory = options[SCRATCH];
+	limits.countEvents = options[COUNT_EVENTS];
+	limits.profile = options[PROFILE];
+
+	unsigned int jobs = 1;
+	if (options[JOBS])
+	{
+		const std::string arg = options[JOBS].arg;
+
+		char *end;
+		const long n = std::strtol(arg.c_str(), &end, 10);
+
+		if (arg.empty() or *end != '\0' or n < 0)
+		{
+			std::cerr
+				<< "Invalid --jobs: '" << arg << "'\n"
+				"(expected a non-negative integer)\n"
+				;
+
+			return Arguments();
+		}
+
+		jobs = static_cast<unsigned int>(n);
+		if (jobs == 0)
+		{
+			jobs = std::max(std::thread::hardware_concurrency(), 1u);
+		}
+	}
+
+	const struct
+	{
+		Options option;
+		size_t &value;
+	} sizes[] =
+	{
+		{ OUTPUT_LIMIT, limits.outputLimit },
+		{ OUTPUT_HEAD, limits.outputHead },
+		{ OUTPUT_TAIL, limits.outputTail },
+		{ MEMORY_LIMIT, limits.resources.memory },
+		{ FILE_SIZE_LIMIT, limits.resources.fileSize },
+	};
+
+	for (auto &s : sizes)
+	{
+		if (not options[s.option])
+			continue;
+
+		const std::string arg = options[s.option].arg;
+
+		if (not ParseSize(arg, s.value))
+		{
+			std::cerr
+				<< "Invalid --" << options[s.option].desc->longopt
+				<< ": '" << arg << "'\n"
+				"(expected a size such as 4096, 64K or 16M)\n"
+				;
+
+			return Arguments();
+		}
+	}
+
+	// Tags and name patterns may be repeated or comma-separated.
+	TestFilter filter;
+	vector<std::string> merge;
+	const struct
+	{
+		Options option;
+		vector<std::string> &values;
+	} lists[] =
+	{
+		{ NAME, filter.names },
+		{ TAGS, filter.tags },
+		{ EXCLUDE_TAGS, filter.excludedTags },
+		{ MERGE, merge },
+	};
+
+	for (auto &l : lists)
+	{
+		for (option::Option *o = options[l.option]; o; o = o->next())
+		{
+			SplitList(o->arg, l.values);
+		}
+	}
+
+	if (options[SHARD])
+	{
+		const std::string arg = options[SHARD].arg;
+
+		char *end;
+		const long i = std::strtol(arg.c_str(), &end, 10);
+		const long n = (*end == '/') ? std::strtol(end + 1, &end, 10) : 0;
+
+		if (*end != '\0' or i < 1 or n < i)
+		{
+			std::cerr
+				<< "Invalid --shard: '" << arg << "'\n"
+				"(expected i/N, where 1 <= i <= N)\n"
+				;
+
+			return Arguments();
+		}
+
+		filter.shard = static_cast<unsigned int>(i - 1);
+		filter.shards = static_cast<unsigned int>(n);
+	}
+
+	CacheOptions cache;
+	if (options[CACHE])
+	{
+		cache.directory = options[CACHE].arg;
+	}
+
+	if (options[SUBMISSION])
+	{
+		cache.submission = options[SUBMISSION].arg;
+	}
+
+	JournalOptions journal;
+	if (options[JOURNAL])
+	{
+		journal.filename = options[JOURNAL].arg;
+	}
+
+	journal.resume = options[RESUME];
+	if (journal.resume and journal.filename.empty())
+	{
+		std::cerr << "--resume requires a --journal to resume from\n";
+		return Arguments();
+	}
+
+	HistoryOptions history;
+	if (options[HISTORY])
+	{
+		history.filename = options[HISTORY].arg;
+	}
+
+	history.suiteOrder = options[SUITE_ORDER];
+
+	CalibrationOptions calibration;
+	if (options[CALIBRATE])
+	{
+		calibration.output = options[CALIBRATE].arg;
+
+		// Cached or journalled results would skew the calibration.
+		if (options[CACHE] or options[JOURNAL])
+		{
+			std::cerr
+				<< "--calibrate can't be used with --cache"
+				" or --journal\n";
+
+			return Arguments();
+		}
+	}
+
+	if (options[CALIBRATION_RUNS])
+	{
+		const std::string arg = options[CALIBRATION_RUNS].arg;
+
+		char *end;
+		const long n = std::strtol(arg.c_str(), &end, 10);
+
+		if (arg.empty() or *end != '\0' or n < 1)
+		{
+			std::cerr
+				<< "Invalid --calibration-runs: '" << arg << "'\n"
+				"(expected a positive integer)\n"
+				;
+
+			return Arguments();
+		}
+
+		calibration.runs = static_cast<unsigned int>(n);
+	}
+
+	if (options[TIMEOUT_PROFILE])
+	{
+		calibration.profile = options[TIMEOUT_PROFILE].arg;
 	}
 
-	return Arguments(false, false, format, skip, strategy, timeout);
+	return Arguments(false, false, format, skip, strategy, limits, jobs,
+	                 filter, merge, cache, journal, history, calibration);
 }
 
 
 Arguments::Arguments(bool help)
-	: error(false), help(help), outputFormat(OutputFormat::Verbose),
-	  skip(false), runStrategy(TestRunStrategy::Inline), timeout(0)
+	: error(true), help(help), outputFormat(OutputFormat::Verbose),
+	  skip(false), runStrategy(TestRunStrategy::Inline), jobs(1)
 {
 }
 
 
 Arguments::Arguments(bool error, bool help, OutputFormat format, bool skip,
-                     TestRunStrategy strategy, time_t timeout)
+                     TestRunStrategy strategy, ChildLimits limits,
+                     unsigned int jobs, TestFilter filter,
+                     vector<std::string> merge, CacheOptions cache,
+                     JournalOptions journal, HistoryOptions history,
+                     CalibrationOptions calibration)
 	: error(error), help(help), outputFormat(format), skip(skip),
-	  runStrategy(strategy), timeout(timeout)
+	  runStrategy(strategy), limits(limits), jobs(jobs),
+	  filter(std::move(filter)), merge(std::move(merge)),
+	  cache(std::move(cache)), journal(std::move(journal)),
+	  history(std::move(history)), calibration(std::move(calibration))
 {
 }
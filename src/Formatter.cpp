@@ -22,8 +22,11 @@
 
 #include <libgrading.h>
 
+#include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cmath>
+#include <iomanip>
 #include <sstream>
 
 using namespace grading;
@@ -56,11 +59,14 @@ private:
 	struct Result
 	{
 		const std::string name;
-		const TestExitStatus status;
-		const std::string output;
+		const std::string description;
+		const TestResult result;    //!< shares the test's output buffers
 		const TagSet tags;
 	};
 
+	//! Write a test's description, output and result as a JSON string.
+	void writeOutput(const Result&);
+
 	const string line_;
 	std::vector<Result> testResults;
 };
@@ -80,9 +86,255 @@ private:
 	const string doubleLine_;
 };
 
+/**
+ * Writes results that can be merged with other shards' results
+ * (see @ref ReadShardResults).
+ */
+class ResultsFormatter : public Formatter
+{
+public:
+	ResultsFormatter(std::ostream &os);
+
+	virtual void testEnded(const Test &test, const TestResult&) override;
+};
+
+/**
+ * Write bytes into a JSON string, escaping non-printing characters.
+ *
+ * Runs of printable characters are written directly from the source buffer.
+ */
+void WriteEscaped(ostream &out, const char *begin, const char *end)
+{
+	const char *run = begin;
+
+	for (const char *p = begin; p != end; p++)
+	{
+		const char c = *p;
+
+		// Print printable things literally, except for "
+		// (which would leave the JSON string).
+		if (isprint(static_cast<unsigned char>(c)) and c != '\"')
+		{
+			continue;
+		}
+
+		out.write(run, p - run);
+		run = p + 1;
+
+		if (c == '\"')
+		{
+			out << "\\\"";
+		}
+		// Escape \t and \n according to C style.
+		else if (c == '\t')
+		{
+			out << "\\t";
+		}
+		else if (c == '\n')
+		{
+			out << "\\n";
+		}
+		else
+		{
+			// Interpret other bytes as hex.
+			const auto uc = static_cast<unsigned char>(c);
+			const auto n = static_cast<unsigned int>(uc);
+
+			out << std::hex << "0x" << n << std::dec;
+		}
+	}
+
+	out.write(run, end - run);
+}
+
+void WriteEscaped(ostream &out, const string &s)
+{
+	WriteEscaped(out, s.data(), s.data() + s.size());
+}
+
+void WriteEscaped(ostream &out, OutputView v)
+{
+	WriteEscaped(out, v.begin(), v.end());
+}
+
+//! Format a duration as a number of seconds (e.g., "1.250").
+string Seconds(std::chrono::microseconds t)
+{
+	ostringstream oss;
+	oss << std::fixed << std::setprecision(3) << (t.count() / 1e6);
+
+	return oss.str();
+}
+
+//! Format a duration as a number of microseconds (e.g., "12.345").
+string Microseconds(std::chrono::nanoseconds t)
+{
+	ostringstream oss;
+	oss << std::fixed << std::setprecision(3) << (t.count() / 1e3);
+
+	return oss.str();
+}
+
+//! Format a number for JSON, which can't represent NaN or infinity.
+string JsonNumber(double x)
+{
+	if (not std::isfinite(x))
+		return "null";
+
+	ostringstream oss;
+	oss << x;
+
+	return oss.str();
+}
+
+//! Format a ratio to a reference (e.g., "1.25").
+string Ratio(double ratio)
+{
+	ostringstream oss;
+	oss << std::fixed << std::setprecision(2) << ratio;
+
+	return oss.str();
+}
+
+//! Describe a benchmark's statistics (over two lines).
+string Describe(const BenchmarkStatistics &b)
+{
+	ostringstream oss;
+	oss
+		<< "Benchmark: median " << Microseconds(b.median)
+		<< " us per iteration (MAD " << Microseconds(b.mad) << " us), "
+		<< Ratio(b.ratio) << " times the reference's "
+		<< Microseconds(b.referenceMedian) << " us\n"
+		<< "Iterations: " << b.iterations << " in " << b.samples
+		<< " samples, " << b.outliers << " outlying samples rejected\n"
+		;
+
+	return oss.str();
+}
+
+/**
+ * Name the event counts that were available (as, e.g., JSON keys).
+ * Counts that couldn't be measured are -1 and are left out.
+ */
+vector<std::pair<string, long long>> Available(const EventCounts &e)
+{
+	const std::pair<string, long long> all[] =
+	{
+		{ "instructions", e.instructions },
+		{ "cycles", e.cycles },
+		{ "cache_misses", e.cacheMisses },
+		{ "branch_misses", e.branchMisses },
+		{ "task_clock_ns", e.taskClock },
+		{ "page_faults", e.pageFaults },
+	};
+
+	vector<std::pair<string, long long>> available;
+	for (auto &event : all)
+	{
+		if (event.second >= 0)
+			available.push_back(event);
+	}
+
+	return available;
+}
+
+//! Describe the events counted during a test (on one line, if any).
+string Describe(const EventCounts &e)
+{
+	const auto available = Available(e);
+	if (available.empty())
+		return "";
+
+	ostringstream oss;
+	oss << (e.multiplexed ? "Events (estimated, multiplexed):" : "Events:");
+
+	for (size_t i = 0; i < available.size(); i++)
+	{
+		string name = available[i].first;
+		std::replace(name.begin(), name.end(), '_', ' ');
+
+		oss
+			<< (i == 0 ? " " : ", ")
+			<< available[i].second << " " << name
+			;
+	}
+
+	oss << "\n";
+
+	return oss.str();
+}
+
+//! The growth function of a complexity class (e.g., "n log n").
+string Growth(Complexity c)
+{
+	ostringstream oss;
+	oss << c;
+
+	// Strip "O(" and ")".
+	const string bigO = oss.str();
+	return bigO.substr(2, bigO.size() - 3);
+}
+
+//! Describe a complexity test's fit and measurements (over several lines).
+string Describe(const ComplexityStatistics &c)
+{
+	const bool instructions = (c.metric == ComplexityMetric::Instructions);
+
+	ostringstream oss;
+	oss
+		<< "Complexity: " << c.fitted << " (expected " << c.expected
+		<< " or better), " << (instructions ? "instructions" : "time")
+		<< " = " << std::setprecision(4) << c.intercept
+		;
+
+	if (c.fitted != Complexity::Constant)
+		oss << " + " << c.coefficient << " * " << Growth(c.fitted);
+
+	oss
+		<< (instructions ? "" : " ns")
+		<< std::fixed << std::setprecision(1)
+		<< " (" << (100 * c.error) << "% RMS error)\n"
+		;
+
+	for (size_t i = 0; i < c.sizes.size(); i++)
+	{
+		oss
+			<< "  n = " << c.sizes[i] << ": "
+			<< Microseconds(c.times[i]) << " us"
+			;
+
+		if (i < c.instructions.size())
+			oss << ", " << c.instructions[i] << " instructions";
+
+		oss << "\n";
+	}
+
+	return oss.str();
+}
+
+//! Describe a test's allocations (on one line).
+string Describe(const AllocationStatistics &a)
+{
+	ostringstream oss;
+	oss
+		<< "Allocations: " << a.allocations << " (" << a.bytes << " B), "
+		<< a.deallocations << " deletions, " << a.peakBytes
+		<< " B peak, " << a.leakedBlocks << " blocks ("
+		<< a.leakedBytes << " B) leaked\n"
+		;
+
+	return oss.str();
+}
+
 } // anonymous namespace
 
 
+std::ostream& grading::operator << (std::ostream &out, OutputView v)
+{
+	return out.write(v.data(), static_cast<std::streamsize>(v.size()));
+}
+
+
 Formatter::Formatter(ostream &os)
 	: out_(os)
 {
@@ -104,6 +356,9 @@ unique_ptr<Formatter> Formatter::Create(OutputFormat format, ostream &out)
 
 	case OutputFormat::Verbose:
 		return unique_ptr<Formatter>(new VerboseFormatter(out));
+
+	case OutputFormat::Results:
+		return unique_ptr<Formatter>(new ResultsFormatter(out));
 	}
 
 	assert(false && "unreachable");
@@ -117,7 +372,23 @@ void BriefFormatter::testBeginning(const Test &test)
 
 void BriefFormatter::testEnded(const Test &test, const TestResult &result)
 {
-	out_ << result.status << "." << std::endl;
+	out_ << result.status << " (" << Seconds(result.usage.wallTime) << " s";
+
+	const BenchmarkStatistics &b = result.benchmark;
+	if (b.samples > 0)
+	{
+		out_
+			<< "; median " << Microseconds(b.median) << " us, "
+			<< Ratio(b.ratio) << "x reference"
+			;
+	}
+
+	if (not result.complexity.sizes.empty())
+	{
+		out_ << "; " << result.complexity.fitted;
+	}
+
+	out_ << ")." << std::endl;
 }
 
 void BriefFormatter::suiteComplete(const TestSuite&,
@@ -127,66 +398,57 @@ void BriefFormatter::suiteComplete(const TestSuite&,
 	{
 		out_
 			<< "Passed " << stats.passed << " out of "
-			<< stats.total << " tests\n"
+			<< stats.total << " tests"
 			;
-	}
-}
 
+		if (stats.skipped > 0)
+			out_ << " (" << stats.skipped << " skipped)";
 
-void GradescopeFormatter::testEnded(const Test &test, const TestResult &result)
-{
-	ostringstream oss;
-	oss
-		<< "Test description:\n" << test.description()
-		<< "\n\n" << line_ << "\nConsole output:\n" << line_ << "\n"
-		<< result.output
-		<< "\n" << line_ << "\nError output:\n" << line_ << "\n"
-		<< result.errorOutput
-		<< "\n" << line_ << "\n"
-		<< "Result: " << result.status << "\n"
-		;
+		out_ << "\n";
 
-	// Escape non-printing characters.
-	ostringstream output;
-	for (char c : oss.str())
-	{
-		// Escape " even though it's printable: don't leave JSON string.
-		if (c == '\"')
+		if (stats.cacheHits > 0 or stats.cacheMisses > 0)
 		{
-			output << "\\\"";
-		}
-		// Print printable things literally.
-		else if (isprint(static_cast<unsigned char>(c)))
-		{
-			output << c;
-		}
-		// Escape \t and \n according to C style.
-		else if (c == '\t')
-		{
-			output << "\\t";
-		}
-		else if (c == '\n')
-		{
-			output << "\\n";
-		}
-		else
-		{
-			// Interpret other bytes as hex.
-			const auto uc = static_cast<unsigned char>(c);
-			const auto n = static_cast<unsigned int>(uc);
-
-			output << std::hex << "0x" << n;
+			out_
+				<< "Result cache: " << stats.cacheHits << " hits, "
+				<< stats.cacheMisses << " misses\n"
+				;
 		}
 	}
+}
+
 
+void GradescopeFormatter::testEnded(const Test &test, const TestResult &result)
+{
+	// Keep the result (not a copy of its output) until the suite is done.
 	testResults.push_back({
 		.name = test.name(),
-		.status = result.status,
-		.output = output.str(),
+		.description = test.description(),
+		.result = result,
 		.tags = test.tags(),
 	});
 }
 
+void GradescopeFormatter::writeOutput(const Result &r)
+{
+	WriteEscaped(out_, "Test description:\n" + r.description + "\n\n");
+	WriteEscaped(out_, line_ + "\nConsole output:\n" + line_ + "\n");
+	WriteEscaped(out_, r.result.outputView());
+	WriteEscaped(out_, "\n" + line_ + "\nError output:\n" + line_ + "\n");
+	WriteEscaped(out_, r.result.errorOutputView());
+	WriteEscaped(out_, "\n" + line_ + "\n");
+
+	ostringstream status;
+	status << "Result: " << r.result.status << "\n";
+
+	if (r.result.benchmark.samples > 0)
+		status << Describe(r.result.benchmark);
+
+	if (not r.result.complexity.sizes.empty())
+		status << Describe(r.result.complexity);
+
+	WriteEscaped(out_, status.str());
+}
+
 void GradescopeFormatter::suiteComplete(const TestSuite&,
                                         TestSuite::Statistics stats)
 {
@@ -203,10 +465,15 @@ void GradescopeFormatter::suiteComplete(const TestSuite&,
 		<< "\"tests\":["
 		;
 
+	std::chrono::microseconds executionTime(0);
+
 	// Sigh, JSON with your lack of support for trailing commas...
 	for (size_t i = 0; i < testResults.size(); i++)
 	{
 		const Result &r = testResults[i];
+		const ResourceUsage &u = r.result.usage;
+
+		executionTime += u.wallTime;
 
 		out_
 			<< "{"
@@ -214,14 +481,138 @@ void GradescopeFormatter::suiteComplete(const TestSuite&,
 			<< "\"name\":\"" << r.name << "\","
 
 			<< "\"score\":"
-			<< ((r.status == TestExitStatus::Pass) ? 1 : 0)
+			<< ((r.result.status == TestExitStatus::Pass) ? 1 : 0)
 			<< ","
 
 			<< "\"max_score\":1,"
 
 			<< "\"output\":\""
-			<< r.output
-			<< "\""
+			;
+
+		writeOutput(r);
+
+		out_
+			<< "\","
+
+			<< "\"extra_data\":{"
+			<< "\"wall_time\":" << Seconds(u.wallTime) << ","
+			<< "\"user_time\":" << Seconds(u.userTime) << ","
+			<< "\"system_time\":" << Seconds(u.systemTime) << ","
+			<< "\"max_rss_kib\":" << u.maxResidentKiB << ","
+			<< "\"minor_faults\":" << u.minorFaults << ","
+			<< "\"major_faults\":" << u.majorFaults << ","
+			<< "\"voluntary_switches\":" << u.voluntarySwitches << ","
+			<< "\"involuntary_switches\":" << u.involuntarySwitches << ","
+			<< "\"stray_processes\":" << u.strayProcesses
+			;
+
+		const auto events = Available(u.events);
+		if (not events.empty())
+		{
+			out_ << ",\"events\":{";
+
+			for (size_t j = 0; j < events.size(); j++)
+			{
+				out_
+					<< (j == 0 ? "" : ",")
+					<< "\"" << events[j].first << "\":"
+					<< events[j].second
+					;
+			}
+
+			if (u.events.multiplexed)
+				out_ << ",\"multiplexed\":true";
+
+			out_ << "}";
+		}
+
+		const ComplexityStatistics &c = r.result.complexity;
+		if (not c.sizes.empty())
+		{
+			out_
+				<< ",\"complexity\":{"
+				<< "\"expected\":\"" << c.expected << "\","
+				<< "\"fitted\":\"" << c.fitted << "\","
+				<< "\"metric\":\""
+				<< (c.metric == ComplexityMetric::Instructions
+				    ? "instructions" : "time")
+				<< "\","
+				<< "\"intercept\":" << JsonNumber(c.intercept) << ","
+				<< "\"coefficient\":" << JsonNumber(c.coefficient)
+				<< ","
+				<< "\"error\":" << JsonNumber(c.error) << ","
+				<< "\"sizes\":["
+				;
+
+			for (size_t j = 0; j < c.sizes.size(); j++)
+			{
+				out_ << (j == 0 ? "" : ",") << c.sizes[j];
+			}
+
+			out_ << "],\"times_us\":[";
+
+			for (size_t j = 0; j < c.times.size(); j++)
+			{
+				out_
+					<< (j == 0 ? "" : ",")
+					<< Microseconds(c.times[j])
+					;
+			}
+
+			out_ << "]";
+
+			if (not c.instructions.empty())
+			{
+				out_ << ",\"instructions\":[";
+
+				for (size_t j = 0; j < c.instructions.size(); j++)
+				{
+					out_
+						<< (j == 0 ? "" : ",")
+						<< c.instructions[j]
+						;
+				}
+
+				out_ << "]";
+			}
+
+			out_ << "}";
+		}
+
+		const AllocationStatistics &a = r.result.allocations;
+		if (a.tracked)
+		{
+			out_
+				<< ",\"allocations\":{"
+				<< "\"allocations\":" << a.allocations << ","
+				<< "\"deallocations\":" << a.deallocations << ","
+				<< "\"bytes\":" << a.bytes << ","
+				<< "\"peak_bytes\":" << a.peakBytes << ","
+				<< "\"leaked_blocks\":" << a.leakedBlocks << ","
+				<< "\"leaked_bytes\":" << a.leakedBytes
+				<< "}"
+				;
+		}
+
+		const BenchmarkStatistics &b = r.result.benchmark;
+		if (b.samples > 0)
+		{
+			out_
+				<< ",\"benchmark\":{"
+				<< "\"median_us\":" << Microseconds(b.median) << ","
+				<< "\"mad_us\":" << Microseconds(b.mad) << ","
+				<< "\"reference_median_us\":"
+				<< Microseconds(b.referenceMedian) << ","
+				<< "\"ratio\":" << Ratio(b.ratio) << ","
+				<< "\"samples\":" << b.samples << ","
+				<< "\"iterations\":" << b.iterations << ","
+				<< "\"outliers\":" << b.outliers
+				<< "}"
+				;
+		}
+
+		out_
+			<< "}"
 
 			<< "}"
 			;
@@ -233,7 +624,42 @@ void GradescopeFormatter::suiteComplete(const TestSuite&,
 		}
 	}
 
-	out_ << "]";
+	out_ << "],";
+
+	// Benchmarks' median times go on the leaderboard (lowest first).
+	vector<const Result*> benchmarks;
+	for (const Result &r : testResults)
+	{
+		if (r.result.benchmark.samples > 0)
+			benchmarks.push_back(&r);
+	}
+
+	if (not benchmarks.empty())
+	{
+		out_ << "\"leaderboard\":[";
+
+		for (size_t i = 0; i < benchmarks.size(); i++)
+		{
+			const Result &r = *benchmarks[i];
+
+			out_
+				<< "{"
+				<< "\"name\":\"" << r.name << " (us)\","
+				<< "\"value\":"
+				<< Microseconds(r.result.benchmark.median) << ","
+				<< "\"order\":\"asc\""
+				<< "}"
+				;
+
+			if ((i + 1) < benchmarks.size())
+			{
+				out_ << ",";
+			}
+		}
+
+		out_ << "],";
+	}
+	out_ << "\"execution_time\":" << Seconds(executionTime);
 	out_ << "}\n";
 }
 
@@ -254,26 +680,60 @@ void VerboseFormatter::testBeginning(const Test &test)
 
 void VerboseFormatter::testEnded(const Test &test, const TestResult &result)
 {
-	out_ << "Result: " << result.status << "\n";
+	const ResourceUsage &u = result.usage;
 
-	if (not result.output.empty())
+	out_
+		<< "Result: " << result.status << "\n"
+		<< "Time: " << Seconds(u.wallTime) << " s wall, "
+		<< Seconds(u.userTime) << " s user, "
+		<< Seconds(u.systemTime) << " s system\n"
+		<< "Memory: " << u.maxResidentKiB << " KiB max RSS, "
+		<< u.minorFaults << " minor and "
+		<< u.majorFaults << " major page faults\n"
+		<< "Context switches: " << u.voluntarySwitches << " voluntary, "
+		<< u.involuntarySwitches << " involuntary\n"
+		;
+
+	if (u.strayProcesses > 0)
+	{
+		out_ << "Stray processes killed: " << u.strayProcesses << "\n";
+	}
+
+	out_ << Describe(u.events);
+
+	if (result.allocations.tracked)
+	{
+		out_ << Describe(result.allocations);
+	}
+
+	if (result.benchmark.samples > 0)
+	{
+		out_ << Describe(result.benchmark);
+	}
+
+	if (not result.complexity.sizes.empty())
+	{
+		out_ << Describe(result.complexity);
+	}
+
+	if (not result.outputView().empty())
 	{
 		out_
 			<< line_ << "\n"
 			<< "Standard output (stdout/cout):\n"
 			<< line_ << "\n"
-			<< result.output
+			<< result.outputView()
 			<< line_ << "\n"
 			;
 	}
 
-	if (not result.errorOutput.empty())
+	if (not result.errorOutputView().empty())
 	{
 		out_
 			<< line_ << "\n"
 			<< "Error output (stderr/cerr):\n"
 			<< line_ << "\n"
-			<< result.errorOutput
+			<< result.errorOutputView()
 			<< line_ << "\n"
 			;
 	}
@@ -288,7 +748,47 @@ void VerboseFormatter::suiteComplete(const TestSuite&,
 	{
 		out_
 			<< "Passed " << stats.passed << " out of "
-			<< stats.total << " tests\n"
+			<< stats.total << " tests"
 			;
+
+		if (stats.skipped > 0)
+			out_ << " (" << stats.skipped << " skipped)";
+
+		out_ << "\n";
+
+		if (stats.cacheHits > 0 or stats.cacheMisses > 0)
+		{
+			out_
+				<< "Result cache: " << stats.cacheHits << " hits, "
+				<< stats.cacheMisses << " misses\n"
+				;
+		}
+
+		// Only count the tests that we actually supervised.
+		const unsigned int run =
+			stats.total - stats.skipped - stats.cacheHits;
+
+		if (stats.supervisionTime.count() > 0 and run > 0)
+		{
+			out_
+				<< "Supervision: " << Seconds(stats.supervisionTime)
+				<< " s of the suite's CPU time ("
+				<< Microseconds(std::chrono::nanoseconds(
+					stats.supervisionTime) / run)
+				<< " us per test)\n"
+				;
+		}
 	}
 }
+
+
+ResultsFormatter::ResultsFormatter(std::ostream &os)
+	: Formatter(os)
+{
+	WriteShardHeader(out_);
+}
+
+void ResultsFormatter::testEnded(const Test &test, const TestResult &result)
+{
+	WriteShardResult(out_, test.index(), result);
+}
@@ -0,0 +1,181 @@
+/*!
+ * @file      Journal.cpp
+ * @brief     Definitions of @ref grading::Journal.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace grading;
+using std::string;
+using std::unique_ptr;
+
+typedef std::chrono::steady_clock Clock;
+
+//! Sync after this many results...
+static const unsigned int SyncResults = 16;
+
+//! ... or when this long has passed since the last sync.
+static const Clock::duration SyncInterval = std::chrono::seconds(1);
+
+
+//! Write all of a buffer to a file descriptor.
+static bool WriteFully(int fd, const string &data)
+{
+	const char *p = data.data();
+	size_t remaining = data.size();
+
+	while (remaining > 0)
+	{
+		const ssize_t n = ::write(fd, p, remaining);
+		if (n < 0 and errno == EINTR)
+			continue;
+
+		if (n <= 0)
+			return false;
+
+		p += n;
+		remaining -= static_cast<size_t>(n);
+	}
+
+	return true;
+}
+
+
+Journal::Journal(const JournalOptions &options,
+                 const std::vector<Test> &tests, uint64_t submission)
+	: submission_(submission), fd_(-1), unsynced_(0),
+	  lastSync_(Clock::now())
+{
+	if (options.resume)
+	{
+		// Keep every complete result, even if the last one is torn.
+		std::map<size_t, TestResult> journalled;
+		std::ifstream in(options.filename, std::ios::binary);
+		ReadShardResults(in, journalled);
+
+		// Drop results that don't belong to these tests.
+		for (const Test &test : tests)
+		{
+			auto r = journalled.find(IdentifyTest(submission_, test));
+			if (r != journalled.end())
+				earlier_.emplace(test.index(), std::move(r->second));
+		}
+	}
+
+	// Start a fresh journal that holds only complete results, then put
+	// it in place of the old one.
+	const string temporary = options.filename + ".tmp";
+	fd_ = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+	           0644);
+
+	if (fd_ < 0)
+	{
+		std::cerr
+			<< "Can't open journal '" << options.filename << "'\n";
+
+		return;
+	}
+
+	std::ostringstream header;
+	WriteShardHeader(header);
+	bool ok = WriteFully(fd_, header.str());
+
+	for (const Test &test : tests)
+	{
+		auto r = earlier_.find(test.index());
+		if (r == earlier_.end())
+			continue;
+
+		std::ostringstream out;
+		WriteShardResult(out, IdentifyTest(submission_, test), r->second);
+		ok = ok and WriteFully(fd_, out.str());
+	}
+
+	if (not ok or fsync(fd_) != 0
+	    or rename(temporary.c_str(), options.filename.c_str()) != 0)
+	{
+		std::cerr
+			<< "Can't write journal '" << options.filename << "'\n";
+
+		close(fd_);
+		fd_ = -1;
+		remove(temporary.c_str());
+	}
+}
+
+
+Journal::~Journal()
+{
+	if (fd_ < 0)
+		return;
+
+	if (unsynced_ > 0)
+		sync();
+
+	close(fd_);
+}
+
+
+unique_ptr<TestResult> Journal::find(const Test &test) const
+{
+	auto r = earlier_.find(test.index());
+	if (r == earlier_.end())
+		return nullptr;
+
+	return unique_ptr<TestResult>(new TestResult(r->second));
+}
+
+
+void Journal::record(const Test &test, const TestResult &result)
+{
+	if (fd_ < 0)
+		return;
+
+	std::ostringstream out;
+	WriteShardResult(out, IdentifyTest(submission_, test), result);
+
+	if (not WriteFully(fd_, out.str()))
+	{
+		std::cerr << "Error writing to journal: no longer journalling\n";
+		close(fd_);
+		fd_ = -1;
+		return;
+	}
+
+	unsynced_++;
+	if (unsynced_ >= SyncResults or Clock::now() - lastSync_ >= SyncInterval)
+	{
+		sync();
+	}
+}
+
+
+void Journal::sync()
+{
+	fsync(fd_);
+	unsynced_ = 0;
+	lastSync_ = Clock::now();
+}
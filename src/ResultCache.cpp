@@ -0,0 +1,226 @@
+/*!
+ * @file      ResultCache.cpp
+ * @brief     Definitions of @ref grading::ResultCache.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <unistd.h>
+
+using namespace grading;
+using std::string;
+using std::unique_ptr;
+
+
+namespace {
+
+//! A 64-bit FNV-1a hash, which can be fed data incrementally.
+class Hash
+{
+	public:
+	Hash() : value_(0xcbf29ce484222325ULL) {}
+
+	Hash& add(const char *data, size_t size)
+	{
+		for (size_t i = 0; i < size; i++)
+		{
+			value_ ^= static_cast<unsigned char>(data[i]);
+			value_ *= 0x100000001b3ULL;
+		}
+
+		return *this;
+	}
+
+	//! Add a string (and its length, so that "ab","c" != "a","bc").
+	Hash& add(const string &s)
+	{
+		add(static_cast<uint64_t>(s.size()));
+		return add(s.data(), s.size());
+	}
+
+	Hash& add(uint64_t n)
+	{
+		return add(reinterpret_cast<const char*>(&n), sizeof(n));
+	}
+
+	uint64_t value() const { return value_; }
+
+	private:
+	uint64_t value_;
+};
+
+
+//! Hash the contents of a file.
+bool HashFile(const string &filename, uint64_t &hash)
+{
+	std::ifstream in(filename, std::ios::binary);
+	if (not in)
+		return false;
+
+	Hash h;
+	char buffer[64 * 1024];
+	while (in.read(buffer, sizeof(buffer)) or in.gcount() > 0)
+	{
+		h.add(buffer, static_cast<size_t>(in.gcount()));
+	}
+
+	hash = h.value();
+	return true;
+}
+
+} // anonymous namespace
+
+
+bool grading::IdentifySubmission(const string &submission,
+                                 const string &executable, uint64_t &id)
+{
+	if (not submission.empty())
+	{
+		id = Hash().add(submission).value();
+		return true;
+	}
+
+	return HashFile("/proc/self/exe", id) or HashFile(executable, id);
+}
+
+
+uint64_t grading::IdentifyTest(uint64_t submission, const Test &test)
+{
+	return Hash()
+		.add(submission)
+		.add(static_cast<uint64_t>(test.index()))
+		.add(test.name())
+		.add(test.description())
+		.value();
+}
+
+
+ResultCache::ResultCache(const CacheOptions &options,
+                         TestRunStrategy strategy, const string &executable)
+	: directory_(options.directory), strategy_(strategy), submission_(0),
+	  usable_(false)
+{
+	if (not IdentifySubmission(options.submission, executable, submission_))
+	{
+		std::cerr
+			<< "Can't read test executable: not caching results\n";
+
+		return;
+	}
+
+	if (mkdir(directory_.c_str(), 0755) != 0 and errno != EEXIST)
+	{
+		std::cerr
+			<< "Can't create cache directory '" << directory_
+			<< "': not caching results\n";
+
+		return;
+	}
+
+	usable_ = true;
+}
+
+
+unique_ptr<TestResult> ResultCache::find(const Test &test,
+                                         const ChildLimits &limits) const
+{
+	std::ifstream in(path(test, limits), std::ios::binary);
+	if (not in)
+		return nullptr;
+
+	std::map<size_t, TestResult> results;
+	if (not ReadShardResults(in, results) or results.size() != 1)
+		return nullptr;
+
+	return unique_ptr<TestResult>(
+		new TestResult(results.begin()->second));
+}
+
+
+void ResultCache::store(const Test &test, const ChildLimits &limits,
+                        const TestResult &result) const
+{
+	// Errors in running the test, rather than in the test itself, might
+	// not happen next time; nor might timeouts on a busy machine.
+	if (result.status == TestExitStatus::OtherError
+	    or result.status == TestExitStatus::Skipped
+	    or result.status == TestExitStatus::Timeout
+	    or result.status == TestExitStatus::CpuLimit)
+	{
+		return;
+	}
+
+	// Write to a temporary file and then rename it, so that concurrent
+	// graders never read a partial result.
+	const string filename = path(test, limits);
+	const string temporary = filename + ".tmp" + std::to_string(getpid());
+
+	{
+		std::ofstream out(temporary, std::ios::binary);
+		WriteShardHeader(out);
+		WriteShardResult(out, test.index(), result);
+
+		if (not out)
+		{
+			remove(temporary.c_str());
+			return;
+		}
+	}
+
+	if (rename(temporary.c_str(), filename.c_str()) != 0)
+	{
+		remove(temporary.c_str());
+	}
+}
+
+
+string ResultCache::path(const Test &test, const ChildLimits &limits) const
+{
+	const ResourceLimits &r = limits.resources;
+
+	Hash h;
+	h.add(submission_)
+		.add(test.name())
+		.add(test.description())
+		.add(static_cast<uint64_t>(strategy_))
+		.add(static_cast<uint64_t>(limits.timeout.count()))
+		.add(limits.outputLimit)
+		.add(limits.outputHead)
+		.add(limits.outputTail)
+		.add(r.memory)
+		.add(static_cast<uint64_t>(r.cpuTime.count()))
+		.add(r.fileSize)
+		.add(r.processes)
+		.add(limits.coreDumps)
+		.add(limits.scratchDirectory)
+		.add(limits.countEvents)
+		.add(limits.profile)
+		;
+
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx",
+	         static_cast<unsigned long long>(h.value()));
+
+	return directory_ + "/" + name;
+}
@@ -0,0 +1,125 @@
+/*!
+ * @file      TagIndex.cpp
+ * @brief     Definitions of @ref grading::TagIndex.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <fnmatch.h>
+
+using namespace grading;
+using std::string;
+using std::vector;
+
+static const size_t WordBits = 64;
+
+
+TagIndex::TagIndex(const vector<Test> &tests)
+{
+	for (const Test &test : tests)
+	{
+		for (const string &tag : test.tags())
+		{
+			ids_.emplace(tag, ids_.size());
+		}
+	}
+
+	words_ = (ids_.size() + WordBits - 1) / WordBits;
+	bits_.resize(tests.size() * words_, 0);
+
+	for (size_t i = 0; i < tests.size(); i++)
+	{
+		Word *bits = bits_.data() + i * words_;
+
+		for (const string &tag : tests[i].tags())
+		{
+			const size_t id = ids_.find(tag)->second;
+			bits[id / WordBits] |= Word(1) << (id % WordBits);
+		}
+	}
+}
+
+
+vector<size_t> TagIndex::select(const vector<Test> &tests,
+                                const TestFilter &filter) const
+{
+	const vector<Word> include = mask(filter.tags);
+	const vector<Word> exclude = mask(filter.excludedTags);
+
+	vector<size_t> selected;
+
+	for (size_t i = 0; i < tests.size(); i++)
+	{
+		if (not filter.tags.empty() and not any(i, include))
+			continue;
+
+		if (any(i, exclude))
+			continue;
+
+		if (not filter.names.empty())
+		{
+			const string &name = tests[i].name();
+			bool matched = false;
+
+			for (const string &pattern : filter.names)
+			{
+				if (fnmatch(pattern.c_str(), name.c_str(), 0) == 0)
+				{
+					matched = true;
+					break;
+				}
+			}
+
+			if (not matched)
+				continue;
+		}
+
+		selected.push_back(i);
+	}
+
+	return selected;
+}
+
+
+vector<TagIndex::Word> TagIndex::mask(const vector<string> &tags) const
+{
+	vector<Word> m(words_, 0);
+
+	for (const string &tag : tags)
+	{
+		auto id = ids_.find(tag);
+		if (id != ids_.end())
+			m[id->second / WordBits] |= Word(1) << (id->second % WordBits);
+	}
+
+	return m;
+}
+
+
+bool TagIndex::any(size_t test, const vector<Word> &mask) const
+{
+	const Word *bits = bits_.data() + test * words_;
+
+	for (size_t w = 0; w < words_; w++)
+	{
+		if (bits[w] & mask[w])
+			return true;
+	}
+
+	return false;
+}
@@ -23,6 +23,8 @@
 #include "private.h"
 
 #include <cassert>
+#include <cstring>
+#include <new>
 
 using namespace grading;
 using std::string;
@@ -30,53 +32,172 @@ using std::string;
 
 Test::Test(string name, string description, TestClosure test,
            time_t timeout, unsigned int weight, TagSet tags)
+	: Test(name, description, test, std::chrono::seconds(timeout),
+	       weight, tags)
+{
+}
+
+
+Test::Test(string name, string description, TestClosure test,
+           Timeout timeout, unsigned int weight, TagSet tags)
 	: name_(name), description_(description), test_(test),
-	  timeout_(timeout), weight_(weight), tags_(tags)
+	  timeout_(timeout), weight_(weight), tags_(tags), outputLimit_(0),
+	  scratchDirectory_(false), countEvents_(false), profile_(false),
+	  index_(0)
 {
 }
 
 
 TestResult Test::Run(TestRunStrategy strategy, time_t timeout) const
 {
-	if (timeout == 0)
-		timeout = timeout_;
+	return Run(strategy, std::chrono::seconds(timeout));
+}
+
 
-	else if (timeout_ != 0)
-		timeout = std::min(timeout, timeout_);
+TestResult Test::Run(TestRunStrategy strategy, Timeout timeout) const
+{
+	ChildLimits suiteLimits;
+	suiteLimits.timeout = timeout;
 
+	clearStatistics();
 
 	switch (strategy)
 	{
 		case TestRunStrategy::Inline:
+		{
+			UsageMeter meter;
 			test_();
-			return TestExitStatus::Pass;
+			return withStatistics(TestResult(TestExitStatus::Pass,
+			                                "", "", meter.elapsed()));
+		}
 
 		case TestRunStrategy::Separated:
-			return ForkTest(test_, timeout);
-
 		case TestRunStrategy::Sandboxed:
-		{
-			TestClosure t = [this]()
-			{
-				EnterSandbox();
-				test_();
-			};
-
-			return ForkTest(t, timeout);
-		}
+		case TestRunStrategy::ForkServer:
+		case TestRunStrategy::Batched:
+			return withStatistics(ForkTest(closure(strategy),
+			                              limits(suiteLimits)));
 	}
 
 	assert(false && "unreachable");
 }
 
 
-TestExitStatus grading::RunInProcess(TestClosure test)
+TestClosure Test::closure(TestRunStrategy strategy) const
+{
+	if (strategy == TestRunStrategy::Inline
+	    or strategy == TestRunStrategy::Separated)
+		return test_;
+
+	return [this]()
+	{
+		EnterSandbox();
+		test_();
+	};
+}
+
+
+//! Combine two limits, where zero means "no limit".
+template<class T>
+static T Tighter(T x, T y)
+{
+	if (x == T())
+		return y;
+
+	else if (y == T())
+		return x;
+
+	return std::min(x, y);
+}
+
+
+ChildLimits Test::limits(const ChildLimits &suiteLimits) const
+{
+	ChildLimits l = suiteLimits;
+	l.timeout = Tighter(suiteLimits.timeout, timeout_);
+	l.outputLimit = Tighter(suiteLimits.outputLimit, outputLimit_);
+
+	const ResourceLimits &suite = suiteLimits.resources;
+	const ResourceLimits &mine = resourceLimits_;
+	l.resources.memory = Tighter(suite.memory, mine.memory);
+	l.resources.cpuTime = Tighter(suite.cpuTime, mine.cpuTime);
+	l.resources.fileSize = Tighter(suite.fileSize, mine.fileSize);
+	l.resources.processes = Tighter(suite.processes, mine.processes);
+
+	l.scratchDirectory = suiteLimits.scratchDirectory or scratchDirectory_;
+	l.countEvents = suiteLimits.countEvents or countEvents_;
+	l.profile = suiteLimits.profile or profile_;
+
+	return l;
+}
+
+
+void Test::clearStatistics() const
+{
+	if (benchmark_)
+		memset(benchmark_->rawPointer(), 0, benchmark_->size());
+
+	if (allocations_)
+		memset(allocations_->rawPointer(), 0, allocations_->size());
+
+	if (complexity_)
+		memset(complexity_->rawPointer(), 0, complexity_->size());
+}
+
+
+TestResult Test::withStatistics(const TestResult &result) const
+{
+	if (not benchmark_ and not allocations_ and not complexity_)
+		return result;
+
+	BenchmarkStatistics benchmark = result.benchmark;
+	if (benchmark_)
+	{
+		BenchmarkStatistics stats;
+		memcpy(&stats, benchmark_->rawPointer(), sizeof(stats));
+
+		// The test may not have got as far as running its benchmark.
+		if (stats.samples > 0)
+			benchmark = stats;
+	}
+
+	AllocationStatistics allocations = result.allocations;
+	if (allocations_)
+		allocations = ReadAllocationCounters(*allocations_);
+
+	ComplexityStatistics complexity = result.complexity;
+	if (complexity_)
+		complexity = ReadComplexityRecord(*complexity_);
+
+	return TestResult(result, benchmark, allocations, complexity);
+}
+
+
+ChildLimits::ChildLimits()
+	: timeout(Timeout::zero()), outputLimit(16 * 1024 * 1024),
+	  outputHead(32 * 1024), outputTail(8 * 1024), coreDumps(false),
+	  scratchDirectory(false), countEvents(false), profile(false)
+{
+}
+
+
+TestExitStatus grading::RunInProcess(TestClosure test,
+                                     const ChildLimits &limits)
 {
 	try
 	{
 		test();
 		return TestExitStatus::Pass;
 	}
+	catch (const std::bad_alloc& e)
+	{
+		std::cerr << "out of memory: " << e.what() << std::endl;
+
+		// Without a limit, this is just another uncaught exception.
+		return (limits.resources.memory != 0)
+			? TestExitStatus::MemoryLimit
+			: TestExitStatus::UncaughtException;
+	}
 	catch (const std::exception& e)
 	{
 		std::cerr
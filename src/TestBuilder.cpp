@@ -19,19 +19,74 @@
  */
 
 #include <libgrading.h>
+#include "private.h"
+
+#include <algorithm>
+
 using namespace grading;
 using std::string;
 
 
 TestBuilder::TestBuilder(string name)
-	: name_(name), timeout_(0), weight_(1)
+	: name_(name), timeout_(Timeout::zero()), weight_(1), outputLimit_(0),
+	  scratchDirectory_(false), countEvents_(false), profile_(false),
+	  trackAllocations_(false), maxAllocations_(0), maxAllocatedBytes_(0),
+	  forbidLeaks_(false), maxRatio_(0), samples_(0),
+	  expectedComplexity_(Complexity::Constant),
+	  complexityMetric_(ComplexityMetric::Time)
 {
 }
 
 
 Test TestBuilder::build() const
 {
-	return Test(name_, description_, test_, timeout_, weight_, tags_);
+	// Benchmarks and allocation counters record their statistics in
+	// memory that is shared with the test suite (which reads them once
+	// the test has finished). Only the test's own closure (not its
+	// benchmark's many iterations) has its allocations tracked.
+	TestClosure closure = test_;
+	std::shared_ptr<SharedMemory> allocations;
+	if (trackAllocations_)
+	{
+		allocations = MapSharedData(sizeof(AllocationCounters));
+		closure = AllocationClosure(test_, maxAllocations_,
+		                            maxAllocatedBytes_, forbidLeaks_,
+		                            allocations);
+	}
+
+	std::shared_ptr<SharedMemory> statistics;
+	if (benchmark_)
+	{
+		statistics = MapSharedData(sizeof(BenchmarkStatistics));
+		closure = BenchmarkClosure(closure, benchmark_, reference_,
+		                           maxRatio_, samples_, statistics);
+	}
+
+	std::shared_ptr<SharedMemory> complexity;
+	if (complexity_)
+	{
+		complexity = MapSharedData(
+			ComplexityRecordSize(complexitySizes_.size()));
+
+		closure = ComplexityClosure(closure, complexity_,
+		                            complexitySizes_,
+		                            expectedComplexity_,
+		                            complexityMetric_, complexity);
+	}
+
+	Test t(name_, description_, closure, timeout_, weight_, tags_);
+	t.outputLimit_ = outputLimit_;
+	t.resourceLimits_ = resourceLimits_;
+	t.scratchDirectory_ = scratchDirectory_;
+	t.countEvents_ = countEvents_;
+	t.profile_ = profile_;
+	t.prerequisites_ = prerequisites_;
+	t.prerequisiteTags_ = prerequisiteTags_;
+	t.benchmark_ = statistics;
+	t.complexity_ = complexity;
+	t.allocations_ = allocations;
+
+	return t;
 }
 
 
@@ -54,3 +109,151 @@ TestBuilder& TestBuilder::description(string d)
 	description_ = d;
 	return *this;
 }
+
+
+TestBuilder& TestBuilder::timeout(time_t t)
+{
+	return timeout(std::chrono::seconds(t));
+}
+
+
+TestBuilder& TestBuilder::timeout(Timeout t)
+{
+	timeout_ = t;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::weight(unsigned int w)
+{
+	weight_ = w;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::outputLimit(size_t bytes)
+{
+	outputLimit_ = bytes;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::memoryLimit(size_t bytes)
+{
+	resourceLimits_.memory = bytes;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::cpuLimit(std::chrono::seconds cpuTime)
+{
+	resourceLimits_.cpuTime = cpuTime;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::fileSizeLimit(size_t bytes)
+{
+	resourceLimits_.fileSize = bytes;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::processLimit(unsigned int processes)
+{
+	resourceLimits_.processes = processes;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::scratchDirectory(bool scratch)
+{
+	scratchDirectory_ = scratch;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::countEvents(bool count)
+{
+	countEvents_ = count;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::profile(bool profile)
+{
+	profile_ = profile;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::trackAllocations(bool track)
+{
+	trackAllocations_ = track;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::maxAllocations(unsigned long allocations)
+{
+	maxAllocations_ = allocations;
+	trackAllocations_ = true;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::maxAllocatedBytes(size_t bytes)
+{
+	maxAllocatedBytes_ = bytes;
+	trackAllocations_ = true;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::forbidLeaks(bool forbid)
+{
+	forbidLeaks_ = forbid;
+	trackAllocations_ = trackAllocations_ or forbid;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::after(string testName)
+{
+	prerequisites_.push_back(testName);
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::afterTag(string tag)
+{
+	prerequisiteTags_.insert(tag);
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::benchmark(TestClosure code, TestClosure reference,
+                                    double maxRatio, unsigned int samples)
+{
+	benchmark_ = code;
+	reference_ = reference;
+	maxRatio_ = maxRatio;
+	samples_ = samples;
+	return *this;
+}
+
+
+TestBuilder& TestBuilder::complexity(SizedClosure code,
+                                     std::vector<size_t> sizes,
+                                     Complexity expected,
+                                     ComplexityMetric metric)
+{
+	// Growth functions such as log n aren't defined below n = 1.
+	sizes.erase(std::remove(sizes.begin(), sizes.end(), 0), sizes.end());
+
+	complexity_ = code;
+	complexitySizes_ = std::move(sizes);
+	expectedComplexity_ = expected;
+	complexityMetric_ = metric;
+	return *this;
+}
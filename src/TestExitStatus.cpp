@@ -41,9 +41,29 @@ std::ostream& grading::operator << (std::ostream& out, TestExitStatus result)
 			out << "uncaught exception";
 			break;
 
+		case TestExitStatus::OutputLimit:
+			out << "output limit exceeded";
+			break;
+
+		case TestExitStatus::MemoryLimit:
+			out << "out of memory";
+			break;
+
+		case TestExitStatus::CpuLimit:
+			out << "CPU time limit exceeded";
+			break;
+
+		case TestExitStatus::FileSizeLimit:
+			out << "file size limit exceeded";
+			break;
+
 		case TestExitStatus::OtherError:
 			out << "unknown test error";
 			break;
+
+		case TestExitStatus::Skipped:
+			out << "skipped";
+			break;
 	}
 
 	return out;
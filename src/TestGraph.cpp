@@ -0,0 +1,222 @@
+/*!
+ * @file      TestGraph.cpp
+ * @brief     Definitions of @ref grading::TestGraph.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+using namespace grading;
+using std::chrono::microseconds;
+using std::set;
+using std::string;
+using std::unordered_map;
+using std::vector;
+
+
+TestGraph::TestGraph(const vector<Test> &tests)
+	: dependents_(tests.size()), waiting_(tests.size(), 0),
+	  done_(tests.size(), false), rank_(tests.size(), 0)
+{
+	const size_t count = tests.size();
+
+	unordered_map<string, vector<size_t>> byName, byTag;
+	for (size_t i = 0; i < count; i++)
+	{
+		byName[tests[i].name()].push_back(i);
+
+		for (const string &tag : tests[i].tags())
+		{
+			byTag[tag].push_back(i);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		set<size_t> prerequisites;
+
+		for (const string &name : tests[i].prerequisites())
+		{
+			auto match = byName.find(name);
+			if (match != byName.end())
+				prerequisites.insert(match->second.begin(),
+				                     match->second.end());
+		}
+
+		for (const string &tag : tests[i].prerequisiteTags())
+		{
+			auto match = byTag.find(tag);
+			if (match != byTag.end())
+				prerequisites.insert(match->second.begin(),
+				                     match->second.end());
+		}
+
+		// A test that has a tag it depends on doesn't wait for itself.
+		prerequisites.erase(i);
+
+		for (size_t p : prerequisites)
+		{
+			dependents_[p].push_back(i);
+		}
+
+		waiting_[i] = prerequisites.size();
+	}
+
+	// Topologically sort the tests, preferring suite order among those
+	// that are ready at the same time. Tests in cycles go last.
+	vector<size_t> unsorted = waiting_;
+	vector<bool> sorted(count, false);
+	set<size_t> available;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (unsorted[i] == 0)
+			available.insert(i);
+	}
+
+	while (not available.empty())
+	{
+		const size_t i = *available.begin();
+		available.erase(available.begin());
+
+		order_.push_back(i);
+		sorted[i] = true;
+
+		for (size_t d : dependents_[i])
+		{
+			if (--unsorted[d] == 0)
+				available.insert(d);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (not sorted[i])
+			order_.push_back(i);
+	}
+
+	// Until we know better, start tests in the order we report them.
+	dispatch_ = order_;
+	for (size_t rank = 0; rank < count; rank++)
+	{
+		const size_t i = dispatch_[rank];
+		rank_[i] = rank;
+
+		if (waiting_[i] == 0)
+			ready_.insert(rank);
+	}
+}
+
+
+void TestGraph::prioritize(const vector<microseconds> &costs)
+{
+	// Dependents come after their prerequisites in order_, so we can work
+	// backwards to find the longest chain of work from each test.
+	vector<microseconds> chain(size());
+	for (auto t = order_.rbegin(); t != order_.rend(); t++)
+	{
+		microseconds longest(0);
+		for (size_t d : dependents_[*t])
+		{
+			longest = std::max(longest, chain[d]);
+		}
+
+		chain[*t] = costs[*t] + longest;
+	}
+
+	// Ties are broken by suite order.
+	std::stable_sort(dispatch_.begin(), dispatch_.end(),
+		[&chain](size_t a, size_t b) { return chain[a] > chain[b]; });
+
+	ready_.clear();
+	for (size_t rank = 0; rank < size(); rank++)
+	{
+		const size_t i = dispatch_[rank];
+		rank_[i] = rank;
+
+		if (waiting_[i] == 0)
+			ready_.insert(rank);
+	}
+}
+
+
+size_t TestGraph::next()
+{
+	if (ready_.empty())
+		return size();
+
+	const size_t rank = *ready_.begin();
+	ready_.erase(ready_.begin());
+
+	return dispatch_[rank];
+}
+
+
+vector<size_t> TestGraph::finished(size_t test, TestExitStatus status)
+{
+	vector<size_t> skipped;
+	vector<std::pair<size_t, bool>> work;
+
+	done_[test] = true;
+	work.emplace_back(test, status == TestExitStatus::Pass);
+
+	while (not work.empty())
+	{
+		const size_t t = work.back().first;
+		const bool passed = work.back().second;
+		work.pop_back();
+
+		for (size_t d : dependents_[t])
+		{
+			if (done_[d])
+				continue;
+
+			// Skip dependents of failed tests right away, rather than
+			// waiting for the rest of their prerequisites.
+			if (not passed)
+			{
+				done_[d] = true;
+				skipped.push_back(d);
+				work.emplace_back(d, false);
+			}
+			else if (--waiting_[d] == 0)
+			{
+				ready_.insert(rank_[d]);
+			}
+		}
+	}
+
+	return skipped;
+}
+
+
+vector<size_t> TestGraph::stuck() const
+{
+	vector<size_t> tests;
+
+	for (size_t i : order_)
+	{
+		if (not done_[i] and waiting_[i] > 0)
+			tests.push_back(i);
+	}
+
+	return tests;
+}
@@ -0,0 +1,123 @@
+/*!
+ * @file      TestHistory.cpp
+ * @brief     Definitions of @ref grading::TestHistory.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+using namespace grading;
+using std::chrono::microseconds;
+using std::string;
+using std::vector;
+
+//! The first line of a history file.
+static const char Header[] = "libgrading-history 1";
+
+
+TestHistory::TestHistory(const string &filename)
+	: filename_(filename), changed_(false)
+{
+	std::ifstream in(filename);
+
+	string line;
+	if (not std::getline(in, line) or line != Header)
+		return;
+
+	long long us;
+	while (in >> us and in.get() == ' ' and std::getline(in, line))
+	{
+		if (us >= 0 and not line.empty())
+			durations_[line] = microseconds(us);
+	}
+}
+
+
+TestHistory::~TestHistory()
+{
+	if (not changed_)
+		return;
+
+	// Replace the old history all at once, so that concurrent or
+	// interrupted runs never leave a half-written file behind.
+	const string temporary = filename_ + ".tmp";
+	{
+		std::ofstream out(temporary);
+		out << Header << "\n";
+
+		for (const auto &d : durations_)
+		{
+			out << d.second.count() << " " << d.first << "\n";
+		}
+
+		if (out.flush()
+		    and std::rename(temporary.c_str(), filename_.c_str()) == 0)
+		{
+			return;
+		}
+	}
+
+	std::cerr << "Can't write history '" << filename_ << "'\n";
+	std::remove(temporary.c_str());
+}
+
+
+vector<microseconds> TestHistory::estimate(const vector<Test> &tests) const
+{
+	microseconds longest(0);
+	for (const auto &d : durations_)
+	{
+		longest = std::max(longest, d.second);
+	}
+
+	vector<microseconds> estimates;
+	for (const Test &test : tests)
+	{
+		auto d = durations_.find(test.name());
+		estimates.push_back((d == durations_.end()) ? longest : d->second);
+	}
+
+	return estimates;
+}
+
+
+void TestHistory::record(const Test &test, const TestResult &result)
+{
+	// Tests that didn't really run say nothing about how long they take,
+	// and names that span lines can't be stored.
+	if (result.status == TestExitStatus::OtherError
+	    or result.status == TestExitStatus::Skipped
+	    or test.name().empty()
+	    or test.name().find('\n') != string::npos)
+	{
+		return;
+	}
+
+	const microseconds took = result.usage.wallTime;
+
+	auto d = durations_.find(test.name());
+	if (d == durations_.end())
+		durations_[test.name()] = took;
+	else
+		d->second = (d->second + took) / 2;
+
+	changed_ = true;
+}
@@ -21,6 +21,8 @@
 #include "private.h"
 #include <libgrading.h>
 #include <cassert>
+#include <fstream>
+#include <set>
 using namespace grading;
 using namespace std;
 
@@ -31,8 +33,11 @@ TestSuite::TestSuite()
 
 
 TestSuite::TestSuite(std::initializer_list<Test> tests)
-	: tests_(tests)
 {
+	for (const Test &t : tests)
+	{
+		add(t);
+	}
 }
 
 
@@ -40,7 +45,7 @@ TestSuite::TestSuite(std::initializer_list<TestBuilder> builders)
 {
 	for (const TestBuilder &tb : builders)
 	{
-		tests_.push_back(tb.build());
+		add(tb.build());
 	}
 }
 
@@ -53,6 +58,7 @@ TestSuite& TestSuite::add(TestBuilder b)
 
 TestSuite& TestSuite::add(Test test)
 {
+	test.index_ = tests_.size();
 	tests_.push_back(move(test));
 	return *this;
 }
@@ -71,9 +77,101 @@ unsigned int TestSuite::totalWeight() const
 }
 
 
+//! Record a test's result in the suite's summary statistics.
+static void Tally(TestSuite::Statistics &stats, const Test &test,
+                  const TestResult &result)
+{
+	stats.total++;
+
+	if (result.status == TestExitStatus::Pass)
+	{
+		stats.passed++;
+		stats.score += test.weight();
+	}
+	else
+	{
+		stats.failed++;
+	}
+
+	if (result.status == TestExitStatus::Skipped)
+	{
+		stats.skipped++;
+	}
+}
+
+
+/**
+ * Look up a test's result from an earlier run: in the journal that we
+ * are resuming from or in the result cache (counting cache hits).
+ */
+static unique_ptr<TestResult> EarlierResult(const ResultCache *cache,
+                                            const Journal *journal,
+                                            const Test &test,
+                                            const ChildLimits &limits,
+                                            TestSuite::Statistics &stats)
+{
+	unique_ptr<TestResult> result;
+
+	if (journal)
+		result = journal->find(test);
+
+	if (not result and cache)
+	{
+		result = cache->find(test, limits);
+		if (result)
+			stats.cacheHits++;
+	}
+
+	return result;
+}
+
+
+//! Save a newly-run test's result in the journal, cache and history.
+static void SaveResult(const ResultCache *cache, Journal *journal,
+                       TestHistory *history, const Test &test,
+                       const ChildLimits &limits, const TestResult &result,
+                       TestSuite::Statistics &stats)
+{
+	if (journal)
+		journal->record(test, result);
+
+	if (history)
+		history->record(test, result);
+
+	if (cache)
+	{
+		cache->store(test, limits, result);
+		stats.cacheMisses++;
+	}
+}
+
+
+//! Set up whatever tests can inherit from the test suite.
+static void PrepareToRun(const vector<Test> &tests, const Arguments &args)
+{
+	if (args.runStrategy != TestRunStrategy::Inline
+	    and args.runStrategy != TestRunStrategy::Separated)
+	{
+		PrepareSandbox();
+	}
+
+	// Tests' scratch directories live within one created by the suite.
+	bool scratch = args.limits.scratchDirectory;
+	for (const Test &test : tests)
+	{
+		scratch = scratch or test.scratchDirectory();
+	}
+
+	if (scratch)
+	{
+		PrepareScratchDirectories();
+	}
+}
+
+
 TestSuite::Statistics TestSuite::Run(int argc, char *argv[]) const
 {
-	Statistics stats = { 0, 0, 0, 0 };
+	Statistics stats = { 0, 0, 0, 0, 0, 0, 0, {} };
 
 	const Arguments args = Arguments::Parse(argc, argv);
 	if (args.error or args.help or args.skip)
@@ -83,28 +181,467 @@ TestSuite::Statistics TestSuite::Run(int argc, char *argv[]) const
 
 	auto f = Formatter::Create(args.outputFormat, cout);
 
-	for (const Test& test : tests_)
+	// Choose which tests to run (by default, all of them).
+	const vector<Test> *tests = &tests_;
+	vector<Test> selected;
+	if (not args.filter.empty())
+	{
+		const TagIndex index(tests_);
+		for (size_t i : index.select(tests_, args.filter))
+		{
+			selected.push_back(tests_[i]);
+		}
+
+		// Shards divide up the selected tests (but merge all of them).
+		if (args.filter.shards > 1 and args.merge.empty())
+		{
+			const vector<Test> all = std::move(selected);
+			selected.clear();
+
+			for (size_t i : ChooseShard(all, args.filter.shard,
+			                            args.filter.shards))
+			{
+				selected.push_back(all[i]);
+			}
+		}
+
+		tests = &selected;
+	}
+
+	// Calibrated timeouts replace the tests' own. While calibrating,
+	// tests run without their own timeouts, so that we can measure how
+	// long they really take (--timeout still applies, though).
+	vector<Test> calibrated;
+	if (not args.calibration.profile.empty()
+	    or not args.calibration.output.empty())
 	{
-		f->testBeginning(test);
-		stats.total++;
+		map<string, Timeout> timeouts;
+		if (not args.calibration.profile.empty()
+		    and not ReadTimeoutProfile(args.calibration.profile,
+		                               timeouts))
+		{
+			cerr << "Error reading timeouts from '"
+				<< args.calibration.profile << "'\n";
+		}
 
-		TestResult result = test.Run(args.runStrategy, args.timeout);
+		for (const Test &test : *tests)
+		{
+			calibrated.push_back(test);
+			Timeout &timeout = calibrated.back().timeout_;
+
+			auto t = timeouts.find(test.name());
+			if (not args.calibration.output.empty())
+				timeout = Timeout::zero();
+
+			else if (t != timeouts.end())
+				timeout = t->second;
+		}
 
-		f->testEnded(test, result);
+		tests = &calibrated;
+	}
 
-		if (result.status == TestExitStatus::Pass)
+	unsigned int weight = 0;
+	for (const Test &test : *tests)
+	{
+		weight += test.weight();
+	}
+
+	if (not args.merge.empty())
+	{
+		MergeResults(*tests, args, *f, stats);
+	}
+	else
+	{
+		unique_ptr<ResultCache> cache;
+		if (not args.cache.directory.empty())
+		{
+			cache.reset(new ResultCache(args.cache, args.runStrategy,
+			                            (argc > 0) ? argv[0] : ""));
+
+			if (not cache->usable())
+				cache.reset();
+		}
+
+		unique_ptr<Journal> journal;
+		if (not args.journal.filename.empty())
 		{
-			stats.passed++;
-			stats.score += test.weight();
+			uint64_t submission = 0;
+			if (not IdentifySubmission(args.cache.submission,
+			                           (argc > 0) ? argv[0] : "",
+			                           submission))
+			{
+				cerr
+					<< "Can't read test executable:"
+					<< " journalling by test names alone\n";
+			}
+
+			journal.reset(new Journal(args.journal, *tests,
+			                          submission));
+
+			if (not journal->usable())
+				journal.reset();
 		}
-		else
+
+		unique_ptr<TestHistory> history;
+		if (not args.history.filename.empty())
 		{
-			stats.failed++;
+			history.reset(new TestHistory(args.history.filename));
 		}
+
+		PrepareToRun(*tests, args);
+
+		// When calibrating, run the suite several times (recording
+		// tests' durations), but only report the last run.
+		unique_ptr<TimeoutCalibration> calibration;
+		unsigned int runs = 1;
+		if (not args.calibration.output.empty())
+		{
+			calibration.reset(new TimeoutCalibration(cout));
+			runs = args.calibration.runs;
+		}
+
+		for (unsigned int run = 1; run <= runs; run++)
+		{
+			Formatter *report = f.get();
+			if (calibration)
+			{
+				calibration->report((run == runs) ? f.get() : nullptr);
+				report = calibration.get();
+			}
+
+			stats = { 0, 0, 0, 0, 0, 0, 0, {} };
+			UsageMeter supervision;
+
+			if (args.runStrategy == TestRunStrategy::ForkServer
+			    or args.runStrategy == TestRunStrategy::Batched
+			    or (args.jobs > 1
+			        and args.runStrategy != TestRunStrategy::Inline))
+			{
+				RunConcurrently(*tests, args, cache.get(),
+				                journal.get(), history.get(),
+				                *report, stats);
+			}
+			else
+			{
+				RunSerially(*tests, args, cache.get(), journal.get(),
+				            history.get(), *report, stats);
+			}
+
+			if (args.runStrategy != TestRunStrategy::Inline)
+			{
+				const ResourceUsage u = supervision.elapsed();
+				stats.supervisionTime = u.userTime + u.systemTime;
+			}
+		}
+
+		if (calibration
+		    and not calibration->save(args.calibration.output))
+		{
+			cerr << "Can't write timeouts to '"
+				<< args.calibration.output << "'\n";
+		}
+	}
+
+	if (weight > 0)
+	{
+		stats.score /= weight;
 	}
 
-	stats.score /= totalWeight();
 	f->suiteComplete(*this, stats);
 
 	return stats;
 }
+
+
+void TestSuite::RunSerially(const vector<Test> &tests, const Arguments &args,
+                            ResultCache *cache, Journal *journal,
+                            TestHistory *history, Formatter &f,
+                            Statistics &stats) const
+{
+	const size_t count = tests.size();
+
+	TestGraph graph(tests);
+	const vector<size_t> &order = graph.order();
+
+	vector<unique_ptr<TestResult>> results(count);
+	size_t reported = 0;     // tests order[0, reported) have been reported
+
+	// Report results in the same order as RunConcurrently does, with
+	// skipped tests in their places rather than as soon as they're known.
+	auto report = [&]()
+	{
+		while (reported < count and results[order[reported]])
+		{
+			const size_t i = order[reported];
+			const Test &test = tests[i];
+
+			f.testBeginning(test);
+			f.testEnded(test, *results[i]);
+			Tally(stats, test, *results[i]);
+
+			results[i].reset();
+			reported++;
+		}
+	};
+
+	for (size_t i = graph.next(); i < count; i = graph.next())
+	{
+		const Test &test = tests[i];
+		const ChildLimits limits = test.limits(args.limits);
+
+		unique_ptr<TestResult> result =
+			EarlierResult(cache, journal, test, limits, stats);
+
+		if (not result)
+		{
+			test.clearStatistics();
+
+			result.reset(new TestResult(test.withStatistics(
+				(args.runStrategy == TestRunStrategy::Inline)
+				? test.Run(args.runStrategy)
+				: ForkTest(test.closure(args.runStrategy),
+				           limits))));
+
+			SaveResult(cache, journal, history, test, limits, *result,
+			           stats);
+		}
+
+		for (size_t s : graph.finished(i, result->status))
+		{
+			results[s].reset(new TestResult(TestExitStatus::Skipped));
+		}
+
+		results[i] = std::move(result);
+		report();
+	}
+
+	for (size_t s : graph.stuck())
+	{
+		results[s].reset(new TestResult(TestExitStatus::Skipped));
+	}
+
+	report();
+}
+
+
+void TestSuite::RunConcurrently(const vector<Test> &tests,
+                                const Arguments &args, ResultCache *cache,
+                                Journal *journal, TestHistory *history,
+                                Formatter &f, Statistics &stats) const
+{
+	const size_t count = tests.size();
+
+	// Test servers must outlive the tests that they are running.
+	vector<unique_ptr<TestServer>> servers;
+	if (args.runStrategy == TestRunStrategy::ForkServer
+	    or args.runStrategy == TestRunStrategy::Batched)
+	{
+		vector<TestClosure> closures;
+		for (const Test &test : tests)
+		{
+			closures.push_back(test.closure(args.runStrategy));
+		}
+
+		for (unsigned int i = 0; i < args.jobs; i++)
+		{
+			unique_ptr<TestServer> server =
+				(args.runStrategy == TestRunStrategy::Batched)
+				? StartBatchServer(closures)
+				: StartForkServer(closures);
+
+			if (server)
+				servers.push_back(std::move(server));
+		}
+	}
+
+	// Start a test in an idle test server, or else in a new process.
+	auto start = [&](size_t i) -> unique_ptr<ChildTest>
+	{
+		const Test &test = tests[i];
+		const ChildLimits limits = test.limits(args.limits);
+
+		test.clearStatistics();
+
+		for (auto &server : servers)
+		{
+			if (not server->busy())
+				return server->start(i, limits);
+		}
+
+		return StartTest(test.closure(args.runStrategy), limits);
+	};
+
+	TestGraph graph(tests);
+	const vector<size_t> &order = graph.order();
+
+	if (history and not args.history.suiteOrder)
+	{
+		graph.prioritize(history->estimate(tests));
+	}
+
+	vector<unique_ptr<ChildTest>> running(count);
+	vector<unique_ptr<TestResult>> results(count);
+	vector<size_t> inFlight;
+
+	// Record a result, skipping any tests that can no longer run.
+	auto finish = [&](size_t i, TestResult result)
+	{
+		for (size_t s : graph.finished(i, result.status))
+		{
+			results[s].reset(new TestResult(TestExitStatus::Skipped));
+		}
+
+		results[i].reset(new TestResult(std::move(result)));
+	};
+
+	size_t reported = 0;     // tests order[0, reported) have been reported
+
+	while (reported < count)
+	{
+		// Keep up to args.jobs child processes busy with ready tests.
+		while (inFlight.size() < args.jobs)
+		{
+			const size_t i = graph.next();
+			if (i == count)
+				break;
+
+			unique_ptr<TestResult> earlier = EarlierResult(cache,
+				journal, tests[i], tests[i].limits(args.limits),
+				stats);
+
+			if (earlier)
+			{
+				finish(i, *earlier);
+				continue;
+			}
+
+			running[i] = start(i);
+
+			if (running[i])
+			{
+				inFlight.push_back(i);
+			}
+			else
+			{
+				finish(i, TestExitStatus::OtherError);
+			}
+		}
+
+		if (not inFlight.empty())
+		{
+			vector<ChildTest*> active;
+			for (size_t i : inFlight)
+			{
+				active.push_back(running[i].get());
+			}
+
+			WaitForAny(active);
+
+			vector<size_t> stillRunning;
+			for (size_t i : inFlight)
+			{
+				if (running[i]->done())
+				{
+					const TestResult result =
+						tests[i].withStatistics(
+							running[i]->result());
+
+					SaveResult(cache, journal, history,
+					           tests[i],
+					           tests[i].limits(args.limits),
+					           result, stats);
+
+					finish(i, result);
+					running[i].reset();
+				}
+				else
+				{
+					stillRunning.push_back(i);
+				}
+			}
+
+			inFlight.swap(stillRunning);
+		}
+		else
+		{
+			// Nothing is running or ready: what's left is in a cycle.
+			for (size_t s : graph.stuck())
+			{
+				results[s].reset(
+					new TestResult(TestExitStatus::Skipped));
+			}
+		}
+
+		// Report results in a repeatable order (suite order, unless
+		// prerequisites say otherwise), regardless of completion order.
+		while (reported < count and results[order[reported]])
+		{
+			const size_t i = order[reported];
+			const Test &test = tests[i];
+
+			f.testBeginning(test);
+			f.testEnded(test, *results[i]);
+			Tally(stats, test, *results[i]);
+
+			results[i].reset();
+			reported++;
+		}
+	}
+}
+
+
+void TestSuite::MergeResults(const vector<Test> &tests, const Arguments &args,
+                             Formatter &f, Statistics &stats) const
+{
+	map<size_t, TestResult> results;
+	std::set<size_t> duplicates;
+
+	for (const string &filename : args.merge)
+	{
+		map<size_t, TestResult> shard;
+
+		ifstream in(filename, std::ios::binary);
+		if (not ReadShardResults(in, shard))
+		{
+			cerr << "Error reading results from '" << filename << "'\n";
+		}
+
+		// Shards are disjoint: a test with two results can't be trusted.
+		for (auto &r : shard)
+		{
+			if (not results.emplace(r.first, std::move(r.second)).second)
+			{
+				cerr
+					<< "More than one result for test " << r.first
+					<< " (in '" << filename << "')\n";
+
+				duplicates.insert(r.first);
+			}
+		}
+	}
+
+	for (size_t i : duplicates)
+	{
+		results.erase(i);
+	}
+
+	// Report tests in the order that a single concurrent run would.
+	const TestGraph graph(tests);
+	for (size_t i : graph.order())
+	{
+		const Test &test = tests[i];
+
+		auto r = results.find(test.index());
+		const string problem = duplicates.count(test.index())
+			? "results for this test in several shards\n"
+			: "no result for this test in any shard\n";
+
+		const TestResult result = (r == results.end())
+			? TestResult(TestExitStatus::OtherError, "", problem)
+			: r->second;
+
+		f.testBeginning(test);
+		f.testEnded(test, result);
+		Tally(stats, test, result);
+	}
+}
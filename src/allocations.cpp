@@ -0,0 +1,151 @@
+/*!
+ * @file      allocations.cpp
+ * @brief     @internal Tracking of tests' allocations (counted by the
+ *            grading-allocations library's operator new and delete).
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+using namespace grading;
+using std::shared_ptr;
+
+
+std::atomic<AllocationCounters*> grading::trackedAllocations(nullptr);
+
+
+AllocationStatistics grading::ReadAllocationCounters(const SharedMemory &shm)
+{
+	const AllocationCounters &c =
+		*static_cast<const AllocationCounters*>(shm.rawPointer());
+
+	AllocationStatistics stats;
+	stats.tracked = c.tracked;
+	stats.allocations = c.allocations;
+	stats.deallocations = c.deallocations;
+	stats.bytes = c.bytes;
+	stats.peakBytes = static_cast<size_t>(std::max(c.peakBytes.load(), 0LL));
+
+	if (c.liveBlocks > 0)
+	{
+		stats.leakedBlocks = static_cast<unsigned long>(c.liveBlocks);
+		stats.leakedBytes =
+			static_cast<size_t>(std::max(c.liveBytes.load(), 0LL));
+	}
+
+	return stats;
+}
+
+
+TestClosure grading::AllocationClosure(TestClosure test,
+                                       unsigned long maxAllocations,
+                                       size_t maxBytes, bool forbidLeaks,
+                                       shared_ptr<SharedMemory> counters)
+{
+	return [=]()
+	{
+		AllocationCounters *c = counters
+			? static_cast<AllocationCounters*>(counters->rawPointer())
+			: nullptr;
+
+		if (not c)
+		{
+			std::cerr << "no memory to count allocations in\n";
+			exit(static_cast<int>(TestExitStatus::OtherError));
+		}
+
+		// Stop counting when the test returns (or throws).
+		struct Tracking
+		{
+			explicit Tracking(AllocationCounters *c)
+			{
+				trackedAllocations = c;
+			}
+
+			~Tracking() { trackedAllocations = nullptr; }
+		};
+
+		// Only the grading-allocations library's operator new counts
+		// anything: check that the program links it, with an
+		// allocation that (unlike a new-expression) can't be elided.
+		{
+			Tracking probe(c);
+			::operator delete(::operator new(1));
+		}
+
+		if (c->allocations == 0)
+		{
+			std::cerr
+				<< "can't track allocations: the test program"
+				" must be linked with grading-allocations\n"
+				;
+
+			exit(static_cast<int>(TestExitStatus::OtherError));
+		}
+
+		c->allocations = 0;
+		c->deallocations = 0;
+		c->bytes = 0;
+		c->liveBlocks = 0;
+		c->liveBytes = 0;
+		c->peakBytes = 0;
+		c->tracked = true;
+
+		if (test)
+		{
+			Tracking tracking(c);
+			test();
+		}
+
+		const AllocationStatistics stats =
+			ReadAllocationCounters(*counters);
+
+		std::ostringstream message;
+
+		if (maxAllocations > 0 and stats.allocations > maxAllocations)
+		{
+			message
+				<< "too many allocations: " << stats.allocations
+				<< " (the limit is " << maxAllocations << ")"
+				;
+		}
+		else if (maxBytes > 0 and stats.peakBytes > maxBytes)
+		{
+			message
+				<< "too much memory allocated: " << stats.peakBytes
+				<< " B live at once (the limit is " << maxBytes
+				<< " B)"
+				;
+		}
+		else if (forbidLeaks and stats.leakedBlocks > 0)
+		{
+			message
+				<< "memory leaked: " << stats.leakedBytes
+				<< " B in " << stats.leakedBlocks << " blocks"
+				;
+		}
+
+		if (not message.str().empty())
+			Fail(message.str());
+	};
+}
@@ -0,0 +1,576 @@
+/*!
+ * @file      benchmark.cpp
+ * @brief     @internal Timing of benchmark tests against reference code
+ *            and of complexity tests at growing input sizes.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+
+using namespace grading;
+using std::shared_ptr;
+using std::vector;
+
+typedef std::chrono::steady_clock Clock;
+
+//! Each timed sample should take at least this long (many clock ticks).
+static const Clock::duration SampleTime = std::chrono::milliseconds(1);
+
+//! Untimed samples to run first (to warm up caches, predictors, etc.).
+static const unsigned int WarmupSamples = 2;
+
+//! Samples more than this many scaled MADs from the median are outliers.
+static const double OutlierThreshold = 3;
+
+//! Scales a MAD to estimate the standard deviation of normal data.
+static const double MadScale = 1.4826;
+
+//! Samples to take of a complexity test at each input size.
+static const unsigned int ComplexitySamples = 9;
+
+/**
+ * A complexity class is chosen over more complex ones if its (relative)
+ * error is within this much of theirs: noisy O(n) times shouldn't be
+ * mistaken for O(n log n).
+ */
+static const double ComplexityTolerance = 0.05;
+
+//! Complexity classes, from simplest to most complex.
+static const Complexity ComplexityClasses[] =
+{
+	Complexity::Constant,
+	Complexity::Logarithmic,
+	Complexity::Linear,
+	Complexity::Linearithmic,
+	Complexity::Quadratic,
+	Complexity::Cubic,
+};
+
+
+//! Time some iterations of a closure [ns].
+static double Time(const TestClosure &f, unsigned long iterations)
+{
+	const Clock::time_point start = Clock::now();
+
+	for (unsigned long i = 0; i < iterations; i++)
+	{
+		f();
+	}
+
+	const std::chrono::duration<double, std::nano> t = Clock::now() - start;
+	return t.count();
+}
+
+
+/**
+ * Choose how many iterations of a closure make up one sample, running
+ * the closure as we go (which also helps to warm it up).
+ */
+static unsigned long SampleSize(const TestClosure &f)
+{
+	const std::chrono::duration<double, std::nano> target = SampleTime;
+
+	unsigned long iterations = 1;
+	while (Time(f, iterations) < target.count())
+	{
+		iterations *= 2;
+	}
+
+	return iterations;
+}
+
+
+//! Find the median of some values.
+static double Median(vector<double> values)
+{
+	const size_t middle = values.size() / 2;
+	std::nth_element(values.begin(), values.begin() + middle, values.end());
+
+	const double upper = values[middle];
+	if (values.size() % 2 == 1)
+		return upper;
+
+	const double lower =
+		*std::max_element(values.begin(), values.begin() + middle);
+
+	return (lower + upper) / 2;
+}
+
+
+SampleSummary grading::Summarize(const vector<double> &samples)
+{
+	auto deviations = [](const vector<double> &values, double median)
+	{
+		vector<double> d;
+		for (double v : values)
+		{
+			d.push_back(std::fabs(v - median));
+		}
+
+		return d;
+	};
+
+	const double median = Median(samples);
+	const double mad = Median(deviations(samples, median));
+
+	vector<double> kept;
+	for (double s : samples)
+	{
+		if (std::fabs(s - median) <= OutlierThreshold * MadScale * mad)
+			kept.push_back(s);
+	}
+
+	// If most samples are identical, the MAD is zero: keep everything.
+	if (kept.size() < (samples.size() + 1) / 2)
+		kept = samples;
+
+	SampleSummary summary;
+	summary.median = Median(kept);
+	summary.mad = Median(deviations(kept, summary.median));
+	summary.outliers = samples.size() - kept.size();
+
+	return summary;
+}
+
+
+BenchmarkStatistics grading::RunBenchmark(const TestClosure &code,
+                                          const TestClosure &reference,
+                                          unsigned int samples)
+{
+	samples = std::max(samples, 1u);
+
+	const unsigned long n = SampleSize(code);
+	const unsigned long r = SampleSize(reference);
+
+	for (unsigned int i = 0; i < WarmupSamples; i++)
+	{
+		Time(code, n);
+		Time(reference, r);
+	}
+
+	// Alternate between the code and the reference, so that both are
+	// equally affected by anything else that's happening on the machine.
+	vector<double> times, referenceTimes;
+	for (unsigned int i = 0; i < samples; i++)
+	{
+		times.push_back(Time(code, n) / n);
+		referenceTimes.push_back(Time(reference, r) / r);
+	}
+
+	const SampleSummary s = Summarize(times);
+	const SampleSummary ref = Summarize(referenceTimes);
+
+	auto ns = [](double t)
+	{
+		return std::chrono::nanoseconds(std::llround(t));
+	};
+
+	BenchmarkStatistics stats;
+	stats.samples = samples;
+	stats.iterations = samples * n;
+	stats.outliers = s.outliers;
+	stats.median = ns(s.median);
+	stats.mad = ns(s.mad);
+	stats.referenceMedian = ns(ref.median);
+	stats.ratio = (ref.median > 0) ? (s.median / ref.median) : 0;
+
+	return stats;
+}
+
+
+TestClosure grading::BenchmarkClosure(TestClosure check, TestClosure code,
+                                      TestClosure reference, double maxRatio,
+                                      unsigned int samples,
+                                      shared_ptr<SharedMemory> statistics)
+{
+	return [=]()
+	{
+		if (check)
+			check();
+
+		const BenchmarkStatistics stats =
+			RunBenchmark(code, reference, samples);
+
+		if (statistics)
+			memcpy(statistics->rawPointer(), &stats, sizeof(stats));
+
+		if (stats.ratio > maxRatio)
+		{
+			std::ostringstream message;
+			message
+				<< std::fixed << std::setprecision(2)
+				<< "too slow: " << stats.ratio
+				<< " times the reference implementation's time"
+				<< " (the limit is " << maxRatio << ")"
+				;
+
+			Fail(message.str());
+		}
+	};
+}
+
+
+//! The growth function of a complexity class, f(n).
+static double Growth(Complexity c, double n)
+{
+	switch (c)
+	{
+	case Complexity::Constant:        return 1;
+	case Complexity::Logarithmic:     return std::log2(n);
+	case Complexity::Linear:          return n;
+	case Complexity::Linearithmic:    return n * std::log2(n);
+	case Complexity::Quadratic:       return n * n;
+	case Complexity::Cubic:           return n * n * n;
+	}
+
+	return 0;
+}
+
+
+//! A complexity test's measurements at one input size.
+struct ComplexityPoint
+{
+	size_t size;
+	long long nanoseconds;      //!< median time
+	long long instructions;     //!< median count (-1 if not counted)
+};
+
+
+//! Measure code at one input size (in the current process).
+static ComplexityPoint Measure(const SizedClosure &code, size_t n,
+                               ComplexityMetric metric)
+{
+	const TestClosure closure = [&code, n]() { code(n); };
+	const unsigned long iterations = SampleSize(closure);
+
+	for (unsigned int i = 0; i < WarmupSamples; i++)
+	{
+		Time(closure, iterations);
+	}
+
+	vector<double> times;
+	for (unsigned int i = 0; i < ComplexitySamples; i++)
+	{
+		times.push_back(Time(closure, iterations) / iterations);
+	}
+
+	ComplexityPoint point;
+	point.size = n;
+	point.nanoseconds = std::llround(Median(times));
+	point.instructions = -1;
+
+	if (metric == ComplexityMetric::Instructions)
+	{
+		vector<double> counts;
+		for (unsigned int i = 0; i < ComplexitySamples; i++)
+		{
+			const long long count = CountInstructions(closure);
+			if (count < 0)
+				return point;
+
+			counts.push_back(static_cast<double>(count));
+		}
+
+		point.instructions = std::llround(Median(counts));
+	}
+
+	return point;
+}
+
+
+//! The start of a complexity test's shared memory.
+struct ComplexityHeader
+{
+	unsigned long count;        //!< measurements recorded (0: none)
+	Complexity expected;
+	ComplexityMetric metric;    //!< the cost to fit
+};
+
+
+size_t grading::ComplexityRecordSize(size_t sizes)
+{
+	return sizeof(ComplexityHeader) + sizes * sizeof(ComplexityPoint);
+}
+
+
+ComplexityStatistics grading::RunComplexity(const SizedClosure &code,
+                                            const vector<size_t> &sizes,
+                                            Complexity expected,
+                                            ComplexityMetric metric,
+                                            const SharedMemory &record)
+{
+	char *base = static_cast<char*>(record.rawPointer());
+	ComplexityHeader *header = reinterpret_cast<ComplexityHeader*>(base);
+	ComplexityPoint *points =
+		reinterpret_cast<ComplexityPoint*>(base + sizeof(*header));
+
+	const size_t capacity =
+		(record.size() - sizeof(*header)) / sizeof(*points);
+
+	const size_t count = std::min(sizes.size(), capacity);
+
+	// Measure each size in a process of its own, so that one size's
+	// heap, caches and predictors don't carry over into the next.
+	// Each process records its measurements straight into the record.
+	for (size_t i = 0; i < count; i++)
+	{
+		ComplexityPoint *point = points + i;
+		const size_t n = sizes[i];
+
+		if (not RunIsolated([&]() { *point = Measure(code, n, metric); }))
+		{
+			std::ostringstream message;
+			message << "complexity test failed at n = " << n;
+			Fail(message.str());
+		}
+	}
+
+	// Fit instruction counts only if every size's could be counted.
+	bool counted = (metric == ComplexityMetric::Instructions);
+	for (size_t i = 0; i < count; i++)
+	{
+		counted = counted and points[i].instructions >= 0;
+	}
+
+	header->expected = expected;
+	header->metric =
+		counted ? ComplexityMetric::Instructions : ComplexityMetric::Time;
+	header->count = count;
+
+	return ReadComplexityRecord(record);
+}
+
+
+void grading::FitComplexity(ComplexityStatistics &stats)
+{
+	const bool instructions =
+		(stats.metric == ComplexityMetric::Instructions);
+
+	const size_t count = std::min(stats.sizes.size(),
+		instructions ? stats.instructions.size() : stats.times.size());
+
+	if (count == 0)
+		return;
+
+	vector<double> costs;
+	for (size_t i = 0; i < count; i++)
+	{
+		costs.push_back(instructions
+			? static_cast<double>(stats.instructions[i])
+			: static_cast<double>(stats.times[i].count()));
+	}
+
+	double mean = 0;
+	for (double cost : costs)
+	{
+		mean += cost / count;
+	}
+
+	// Fit cost = intercept + coefficient * f(n) for each class by least
+	// squares. The intercept absorbs fixed overheads (e.g., calls and
+	// setup) that would otherwise make small sizes look relatively slow.
+	struct Fit
+	{
+		Complexity complexity;
+		double intercept;
+		double coefficient;
+		double error;
+	};
+
+	vector<Fit> fits;
+	for (Complexity c : ComplexityClasses)
+	{
+		double intercept = mean, coefficient = 0;
+
+		// A constant cost is all intercept.
+		if (c != Complexity::Constant)
+		{
+			double meanF = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				meanF += Growth(c, stats.sizes[i]) / count;
+			}
+
+			double ff = 0, cf = 0;
+			for (size_t i = 0; i < count; i++)
+			{
+				const double f = Growth(c, stats.sizes[i]) - meanF;
+				ff += f * f;
+				cf += (costs[i] - mean) * f;
+			}
+
+			if (ff == 0 or not std::isfinite(ff) or not std::isfinite(cf))
+				continue;
+
+			coefficient = cf / ff;
+			intercept = mean - coefficient * meanF;
+
+			// Overheads can't be negative: if the best line needs a
+			// negative intercept, the best that can is through 0.
+			if (intercept < 0)
+			{
+				double ff0 = 0, cf0 = 0;
+				for (size_t i = 0; i < count; i++)
+				{
+					const double f = Growth(c, stats.sizes[i]);
+					ff0 += f * f;
+					cf0 += costs[i] * f;
+				}
+
+				intercept = 0;
+				coefficient = cf0 / ff0;
+			}
+
+			// Costs that shrink as n grows aren't this kind of growth.
+			if (coefficient < 0)
+				continue;
+		}
+
+		double squares = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			const double residual = costs[i]
+				- (intercept + coefficient * Growth(c, stats.sizes[i]));
+
+			squares += residual * residual;
+		}
+
+		const double rms = std::sqrt(squares / count);
+		const double error = (mean > 0) ? rms / mean : 0;
+
+		// Don't let a class that can't describe these sizes win the fit.
+		if (not std::isfinite(intercept) or not std::isfinite(coefficient)
+		    or not std::isfinite(error))
+		{
+			continue;
+		}
+
+		fits.push_back({ c, intercept, coefficient, error });
+	}
+
+	if (fits.empty())
+		return;
+
+	double best = fits.front().error;
+	for (const Fit &fit : fits)
+	{
+		best = std::min(best, fit.error);
+	}
+
+	for (const Fit &fit : fits)
+	{
+		if (fit.error <= best + ComplexityTolerance)
+		{
+			stats.fitted = fit.complexity;
+			stats.intercept = fit.intercept;
+			stats.coefficient = fit.coefficient;
+			stats.error = fit.error;
+			break;
+		}
+	}
+}
+
+
+ComplexityStatistics grading::ReadComplexityRecord(const SharedMemory &record)
+{
+	const char *base = static_cast<const char*>(record.rawPointer());
+	const ComplexityHeader *header =
+		reinterpret_cast<const ComplexityHeader*>(base);
+	const ComplexityPoint *points =
+		reinterpret_cast<const ComplexityPoint*>(base + sizeof(*header));
+
+	const size_t capacity =
+		(record.size() - sizeof(*header)) / sizeof(*points);
+
+	ComplexityStatistics stats;
+	stats.expected = header->expected;
+	stats.metric = header->metric;
+
+	const size_t count = std::min<size_t>(header->count, capacity);
+	for (size_t i = 0; i < count; i++)
+	{
+		stats.sizes.push_back(points[i].size);
+		stats.times.emplace_back(points[i].nanoseconds);
+
+		if (stats.metric == ComplexityMetric::Instructions)
+			stats.instructions.push_back(points[i].instructions);
+	}
+
+	FitComplexity(stats);
+
+	return stats;
+}
+
+
+TestClosure grading::ComplexityClosure(TestClosure check, SizedClosure code,
+                                       vector<size_t> sizes,
+                                       Complexity expected,
+                                       ComplexityMetric metric,
+                                       shared_ptr<SharedMemory> record)
+{
+	return [=]()
+	{
+		if (check)
+			check();
+
+		if (not record or not record->rawPointer())
+		{
+			Fail("no memory to record complexity measurements in");
+			return;
+		}
+
+		const ComplexityStatistics stats =
+			RunComplexity(code, sizes, expected, metric, *record);
+
+		if (stats.fitted > expected)
+		{
+			std::ostringstream message;
+			message
+				<< "too slow: "
+				<< (stats.metric == ComplexityMetric::Instructions
+				    ? "instruction count" : "running time")
+				<< " grows as " << stats.fitted
+				<< " (expected " << expected << " or better)"
+				;
+
+			Fail(message.str());
+		}
+	};
+}
+
+
+std::ostream& grading::operator << (std::ostream &out, Complexity c)
+{
+	switch (c)
+	{
+	case Complexity::Constant:        out << "O(1)"; break;
+	case Complexity::Logarithmic:     out << "O(log n)"; break;
+	case Complexity::Linear:          out << "O(n)"; break;
+	case Complexity::Linearithmic:    out << "O(n log n)"; break;
+	case Complexity::Quadratic:       out << "O(n^2)"; break;
+	case Complexity::Cubic:           out << "O(n^3)"; break;
+	}
+
+	return out;
+}
@@ -0,0 +1,134 @@
+/*!
+ * @file      calibration.cpp
+ * @brief     @internal Calibration of tests' timeouts from their durations.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+using namespace grading;
+using std::chrono::duration_cast;
+using std::chrono::microseconds;
+using std::map;
+using std::string;
+using std::vector;
+
+
+//! The first line of a timeout profile: a name and a format version.
+static const char ProfileHeader[] = "libgrading-timeouts 1";
+
+//! Timeouts are this multiple of tests' 95th-percentile durations...
+static const unsigned int TimeoutFactor = 3;
+
+//! ... plus this much, so that very quick tests aren't killed by noise.
+static const Timeout TimeoutFloor = std::chrono::seconds(1);
+
+
+TimeoutCalibration::TimeoutCalibration(std::ostream &out)
+	: Formatter(out), report_(nullptr)
+{
+}
+
+
+void TimeoutCalibration::testBeginning(const Test &test)
+{
+	if (report_)
+		report_->testBeginning(test);
+}
+
+
+void TimeoutCalibration::testEnded(const Test &test, const TestResult &result)
+{
+	if (report_)
+		report_->testEnded(test, result);
+
+	// Tests that didn't really run, or were cut short, say nothing about
+	// how long they take. Names that span lines can't be stored.
+	if (result.status == TestExitStatus::OtherError
+	    or result.status == TestExitStatus::Skipped
+	    or result.status == TestExitStatus::Timeout
+	    or result.status == TestExitStatus::CpuLimit
+	    or test.name().empty()
+	    or test.name().find('\n') != string::npos)
+	{
+		return;
+	}
+
+	samples_[test.name()].push_back(result.usage.wallTime);
+}
+
+
+bool TimeoutCalibration::save(const string &filename) const
+{
+	// Replace any old profile all at once.
+	const string temporary = filename + ".tmp";
+	{
+		std::ofstream out(temporary);
+		out << ProfileHeader << "\n";
+
+		for (const auto &s : samples_)
+		{
+			// The nearest-rank 95th percentile: with only a few
+			// samples, this is the slowest.
+			vector<microseconds> durations = s.second;
+			std::sort(durations.begin(), durations.end());
+
+			const size_t rank = (durations.size() * 95 + 99) / 100;
+			const microseconds p95 = durations[rank - 1];
+
+			const Timeout timeout = TimeoutFloor
+				+ duration_cast<Timeout>(p95 * TimeoutFactor);
+
+			out << timeout.count() << " " << s.first << "\n";
+		}
+
+		if (out.flush()
+		    and std::rename(temporary.c_str(), filename.c_str()) == 0)
+		{
+			return true;
+		}
+	}
+
+	std::remove(temporary.c_str());
+	return false;
+}
+
+
+bool grading::ReadTimeoutProfile(const string &filename,
+                                 map<string, Timeout> &timeouts)
+{
+	std::ifstream in(filename);
+
+	string line;
+	if (not std::getline(in, line) or line != ProfileHeader)
+		return false;
+
+	long long ms;
+	while (in >> ms and in.get() == ' ' and std::getline(in, line))
+	{
+		if (ms <= 0 or line.empty())
+			return false;
+
+		timeouts[line] = Timeout(ms);
+	}
+
+	return in.eof();
+}
@@ -0,0 +1,197 @@
+/*!
+ * @file      capture.cpp
+ * @brief     @internal POSIX implementation of @ref grading::OutputCapture.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "posix.h"
+
+#include <algorithm>
+#include <cassert>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace grading;
+using std::string;
+
+
+OutputCapture::OutputCapture(size_t head, size_t tail)
+	: read_(-1), write_(-1), eof_(false), hidden_(false)
+{
+	clear(head, tail);
+}
+
+
+OutputCapture::~OutputCapture()
+{
+	if (hidden_)
+		RevealToTests(read_);
+
+	if (read_ >= 0)
+		close(read_);
+
+	closeWriteEnd();
+}
+
+
+bool OutputCapture::open()
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+	{
+		return false;
+	}
+
+	// We drain the pipe whenever it's readable, but never block on it.
+	const int flags = fcntl(fds[0], F_GETFL);
+	if (flags < 0 or fcntl(fds[0], F_SETFL, flags | O_NONBLOCK) < 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+
+	read_ = fds[0];
+	write_ = fds[1];
+
+	return true;
+}
+
+
+void OutputCapture::closeWriteEnd()
+{
+	if (write_ >= 0)
+	{
+		close(write_);
+		write_ = -1;
+	}
+}
+
+
+void OutputCapture::hideFromTests()
+{
+	if (read_ >= 0)
+	{
+		HideFromTests(read_);
+		hidden_ = true;
+	}
+}
+
+
+void OutputCapture::drain(size_t maximum)
+{
+	char buffer[16 * 1024];
+	size_t bytesRead = 0;
+
+	while (not eof_ and read_ >= 0
+	       and (maximum == 0 or bytesRead < maximum))
+	{
+		ssize_t n = read(read_, buffer, sizeof(buffer));
+
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			assert(errno == EAGAIN or errno == EWOULDBLOCK);
+			return;
+		}
+
+		if (n == 0)
+		{
+			eof_ = true;
+			return;
+		}
+
+		const char *data = buffer;
+		size_t len = static_cast<size_t>(n);
+		bytesRead += len;
+		total_ += len;
+
+		// Fill the head first...
+		if (headBuffer_.size() < head_)
+		{
+			const size_t count = std::min(len, head_ - headBuffer_.size());
+			headBuffer_.append(data, count);
+			data += count;
+			len -= count;
+		}
+
+		// ... then keep the most recent bytes in the tail ring.
+		if (tail_ == 0)
+			continue;
+
+		if (len > tail_)
+		{
+			data += (len - tail_);
+			len = tail_;
+		}
+
+		for (size_t i = 0; i < len; i++)
+		{
+			if (tailLength_ < tail_)
+			{
+				tailBuffer_[(tailStart_ + tailLength_) % tail_] = data[i];
+				tailLength_++;
+			}
+			else
+			{
+				tailBuffer_[tailStart_] = data[i];
+				tailStart_ = (tailStart_ + 1) % tail_;
+			}
+		}
+	}
+}
+
+
+string OutputCapture::release()
+{
+	// Build the result in the head buffer rather than copying it.
+	string s;
+	s.swap(headBuffer_);
+
+	const size_t omitted = total_ - s.size() - tailLength_;
+	if (omitted > 0)
+	{
+		s += "\n[... " + std::to_string(omitted) + " bytes omitted ...]\n";
+	}
+
+	// Unroll the tail ring: its oldest bytes are at tailStart_.
+	const size_t wrapped = std::min(tailLength_, tail_ - tailStart_);
+	s.append(tailBuffer_.data() + tailStart_, wrapped);
+	s.append(tailBuffer_.data(), tailLength_ - wrapped);
+
+	tailLength_ = 0;
+	tailStart_ = 0;
+
+	return s;
+}
+
+
+void OutputCapture::clear(size_t head, size_t tail)
+{
+	head_ = head;
+	tail_ = tail;
+
+	headBuffer_.clear();
+	tailBuffer_.assign(tail, '\0');
+	tailStart_ = 0;
+	tailLength_ = 0;
+	total_ = 0;
+}
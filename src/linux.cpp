@@ -0,0 +1,511 @@
+/*!
+ * @file      linux.cpp
+ * @brief     @internal Linux implementation of @ref grading::PrepareSandbox,
+ *            @ref grading::EnterSandbox, private tmpfs mounts and
+ *            event counters.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+#include "posix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/perf_event.h>
+#include <linux/seccomp.h>
+
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <sysexits.h>
+#include <unistd.h>
+
+using namespace grading;
+using std::string;
+using std::vector;
+
+
+#if defined(__x86_64__)
+#define SANDBOX_AUDIT_ARCH AUDIT_ARCH_X86_64
+#elif defined(__aarch64__)
+#define SANDBOX_AUDIT_ARCH AUDIT_ARCH_AARCH64
+#else
+#warning No seccomp filter for this architecture: tests only get namespaces
+#endif
+
+
+namespace {
+
+//! Have namespaces been set up (perhaps in an ancestor process)?
+bool namespacesReady = false;
+
+//! Can test processes set up namespaces (as checked by PrepareSandbox)?
+bool namespacesAvailable = false;
+
+//! Has this process installed its seccomp filter?
+pid_t filteredProcess = 0;
+
+#ifdef SANDBOX_AUDIT_ARCH
+//! The seccomp filter, built once for every test (see @ref BuildFilter).
+vector<struct sock_filter> filter;
+
+//! Instructions in @ref filter that compare against the filtered process ID.
+vector<size_t> processChecks;
+#endif
+
+
+//! Write a string to a (/proc) file.
+bool WriteFile(const char *path, const string &contents)
+{
+	int fd = open(path, O_WRONLY | O_CLOEXEC);
+	if (fd < 0)
+		return false;
+
+	ssize_t n = write(fd, contents.data(), contents.size());
+	close(fd);
+
+	return n == static_cast<ssize_t>(contents.size());
+}
+
+
+/**
+ * Move into new user, network, mount and IPC namespaces.
+ *
+ * The user namespace lets an unprivileged process create the others; within
+ * it, we map our own UID and GID to themselves. The network namespace has
+ * no interfaces except a loopback device that is down. Mounts are made
+ * private so that tests' mounts never propagate back to the host.
+ */
+bool EnterNamespaces()
+{
+	const uid_t uid = geteuid();
+	const gid_t gid = getegid();
+
+	if (unshare(CLONE_NEWUSER | CLONE_NEWNET | CLONE_NEWNS | CLONE_NEWIPC)
+	    != 0)
+	{
+		return false;
+	}
+
+	// We must give up setgroups(2) before writing a GID map.
+	if (not WriteFile("/proc/self/setgroups", "deny")
+	    or not WriteFile("/proc/self/uid_map",
+	                     std::to_string(uid) + " " + std::to_string(uid)
+	                     + " 1")
+	    or not WriteFile("/proc/self/gid_map",
+	                     std::to_string(gid) + " " + std::to_string(gid)
+	                     + " 1"))
+	{
+		return false;
+	}
+
+	return mount(nullptr, "/", nullptr, MS_REC | MS_PRIVATE, nullptr) == 0;
+}
+
+
+#ifdef SANDBOX_AUDIT_ARCH
+
+/**
+ * System calls that tests may make.
+ *
+ * These are enough for ordinary computation, memory management, file I/O,
+ * threads and child processes. Anything else (e.g., creating sockets,
+ * executing programs, mounting filesystems or tracing other processes)
+ * fails with EPERM. Signals are handled separately: see @ref BuildFilter.
+ */
+const int AllowedSyscalls[] =
+{
+	// I/O on descriptors
+	__NR_read, __NR_write, __NR_readv, __NR_writev,
+	__NR_pread64, __NR_pwrite64, __NR_preadv, __NR_pwritev,
+	__NR_lseek, __NR_close, __NR_dup, __NR_dup3, __NR_fcntl, __NR_ioctl,
+	__NR_fstat, __NR_fstatfs, __NR_ftruncate, __NR_fsync, __NR_fdatasync,
+	__NR_flock, __NR_getdents64, __NR_pipe2, __NR_socketpair,
+	__NR_sendto, __NR_recvfrom, __NR_sendmsg, __NR_recvmsg, __NR_shutdown,
+	__NR_ppoll, __NR_pselect6, __NR_epoll_create1, __NR_epoll_ctl,
+	__NR_epoll_pwait, __NR_eventfd2,
+#ifdef __NR_dup2
+	__NR_dup2, __NR_pipe, __NR_poll, __NR_select, __NR_epoll_wait,
+#endif
+
+	// Files (subject to the usual permission checks)
+	__NR_openat, __NR_newfstatat, __NR_statx, __NR_faccessat,
+	__NR_readlinkat, __NR_unlinkat, __NR_mkdirat, __NR_renameat2,
+	__NR_getcwd, __NR_chdir, __NR_fchdir, __NR_truncate, __NR_umask,
+#ifdef __NR_open
+	__NR_open, __NR_creat, __NR_stat, __NR_lstat, __NR_access,
+	__NR_readlink, __NR_unlink, __NR_mkdir, __NR_rename, __NR_rmdir,
+#endif
+#ifdef __NR_faccessat2
+	__NR_faccessat2,
+#endif
+
+	// Memory
+	__NR_brk, __NR_mmap, __NR_munmap, __NR_mremap, __NR_mprotect,
+	__NR_madvise, __NR_msync, __NR_mincore, __NR_membarrier,
+
+	// Processes and threads
+	__NR_clone, __NR_wait4, __NR_waitid, __NR_exit, __NR_exit_group,
+	__NR_set_tid_address, __NR_set_robust_list, __NR_get_robust_list,
+	__NR_futex, __NR_sched_yield, __NR_sched_getaffinity,
+	__NR_getpid, __NR_getppid, __NR_gettid, __NR_getpgid, __NR_getsid,
+	__NR_getuid, __NR_geteuid, __NR_getgid, __NR_getegid, __NR_getgroups,
+	__NR_prctl, __NR_prlimit64, __NR_getrlimit, __NR_setrlimit,
+	__NR_getrusage, __NR_times, __NR_uname, __NR_sysinfo, __NR_getrandom,
+#ifdef __NR_fork
+	__NR_fork, __NR_vfork, __NR_getpgrp, __NR_arch_prctl,
+#endif
+#ifdef __NR_clone3
+	__NR_clone3,
+#endif
+#ifdef __NR_rseq
+	__NR_rseq,
+#endif
+
+	// Signals (but see kill(2) and tgkill(2) below)
+	__NR_rt_sigaction, __NR_rt_sigprocmask, __NR_rt_sigreturn,
+	__NR_rt_sigsuspend, __NR_rt_sigtimedwait, __NR_sigaltstack,
+	__NR_restart_syscall,
+
+	// Time
+	__NR_clock_gettime, __NR_clock_getres, __NR_clock_nanosleep,
+	__NR_nanosleep, __NR_gettimeofday, __NR_getitimer, __NR_setitimer,
+	__NR_timer_create, __NR_timer_settime, __NR_timer_gettime,
+	__NR_timer_delete,
+#ifdef __NR_alarm
+	__NR_alarm, __NR_time,
+#endif
+};
+
+
+/**
+ * Build a seccomp-bpf program that allows @ref AllowedSyscalls into
+ * @ref filter.
+ *
+ * Signals may only be sent to this process (or its process group), so that
+ * tests can't signal the test suite, and performance counters may only be
+ * opened for this process. The program is built before we know which
+ * process will install it: that process must fill in its ID at each of the
+ * instructions listed in @ref processChecks.
+ */
+void BuildFilter()
+{
+	const __u32 deny = SECCOMP_RET_ERRNO | (EPERM & SECCOMP_RET_DATA);
+
+	vector<struct sock_filter> &p = filter;
+	p.clear();
+	processChecks.clear();
+
+	auto stmt = [&](__u16 code, __u32 k)
+	{
+		p.push_back(BPF_STMT(code, k));
+	};
+
+	// Jump to "allow" if the accumulator equals k (else fall through).
+	// Offsets are patched once we know where "allow" is.
+	vector<size_t> toAllow;
+	auto allowIf = [&](__u32 k)
+	{
+		toAllow.push_back(p.size());
+		p.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, k, 0, 0));
+	};
+
+	// Jump to "allow" if the accumulator is the filtered process' ID.
+	auto allowIfSelf = [&]()
+	{
+		processChecks.push_back(p.size());
+		allowIf(0);
+	};
+
+	// Kill anything that uses a different system call ABI.
+	stmt(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch));
+	p.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+	                     SANDBOX_AUDIT_ARCH, 1, 0));
+	stmt(BPF_RET | BPF_K, SECCOMP_RET_KILL);
+
+	stmt(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr));
+	for (int nr : AllowedSyscalls)
+	{
+		allowIf(static_cast<__u32>(nr));
+	}
+
+	// kill(2): only to ourselves or our own process group.
+	p.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_kill, 0, 4));
+	stmt(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, args[0]));
+	allowIf(0);
+	allowIfSelf();
+	stmt(BPF_RET | BPF_K, deny);
+
+	// tgkill(2): only to our own threads (as in raise(3) and abort(3)).
+	p.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, __NR_tgkill, 0, 3));
+	stmt(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, args[0]));
+	allowIfSelf();
+	stmt(BPF_RET | BPF_K, deny);
+
+	// perf_event_open(2): only to count ourselves (as complexity tests do
+	// when they count instructions).
+	p.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+	                     __NR_perf_event_open, 0, 3));
+	stmt(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, args[1]));
+	allowIf(0);
+	stmt(BPF_RET | BPF_K, deny);
+
+	stmt(BPF_RET | BPF_K, deny);
+
+	const size_t allow = p.size();
+	stmt(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+
+	for (size_t i : toAllow)
+	{
+		p[i].jt = static_cast<__u8>(allow - i - 1);
+	}
+}
+
+#endif // SANDBOX_AUDIT_ARCH
+
+
+//! The events that we count, in the order of @ref EventCounts' fields.
+const struct { __u32 type; __u64 config; } Events[] =
+{
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+	{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK },
+	{ PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+};
+
+} // anonymous namespace
+
+
+void grading::PrepareSandbox()
+{
+#ifdef SANDBOX_AUDIT_ARCH
+	// Every test process installs the same filter: build it once, here.
+	if (filter.empty())
+		BuildFilter();
+#endif
+
+	// The test suite stays where it is: only test processes (and the
+	// servers that fork them) enter namespaces. Check that they'll be
+	// able to, in a child that we throw away. If they can't (e.g.,
+	// unprivileged user namespaces are disabled), tests are still
+	// confined by their seccomp filters.
+	if (namespacesReady)
+	{
+		namespacesAvailable = true;
+		return;
+	}
+
+	const pid_t child = fork();
+	if (child == 0)
+		_exit(EnterNamespaces() ? 0 : 1);
+
+	int status = 0;
+	while (child > 0 and waitpid(child, &status, 0) < 0 and errno == EINTR)
+	{
+	}
+
+	namespacesAvailable = child > 0
+		and WIFEXITED(status) and WEXITSTATUS(status) == 0;
+}
+
+
+void grading::EnterSandboxNamespaces()
+{
+	if (not namespacesReady)
+		namespacesReady = EnterNamespaces();
+}
+
+
+bool grading::PrivateMountsAvailable()
+{
+	return namespacesAvailable;
+}
+
+
+bool grading::MountPrivateTmpfs(const string &dir)
+{
+	// Test processes mount their tmpfs before they enter the rest of the
+	// sandbox, but the mount needs a user namespace of our own.
+	EnterSandboxNamespaces();
+	if (not namespacesReady)
+		return false;
+
+	// A new mount namespace (owned by our user namespace) keeps the tmpfs
+	// private to this process and its descendants: when they have all
+	// exited, the kernel unmounts it and frees its contents.
+	if (unshare(CLONE_NEWNS) != 0)
+		return false;
+
+	return mount("tmpfs", dir.c_str(), "tmpfs", MS_NOSUID | MS_NODEV,
+	             "mode=0700") == 0;
+}
+
+
+EventCounters::EventCounters(pid_t pid)
+	: leader_(-1)
+{
+	for (auto &e : Events)
+	{
+		struct perf_event_attr attr;
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = e.type;
+		attr.config = e.config;
+
+		// Count the test and any processes or threads that it creates,
+		// but (so that we don't need any privilege) only in user mode.
+		attr.inherit = 1;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+
+		// The first event that we can count leads a group: the kernel
+		// schedules the whole group onto the PMU together, so its
+		// counts all cover the same time, and it tells us how much of
+		// that time the group was actually counting.
+		attr.read_format = PERF_FORMAT_GROUP
+			| PERF_FORMAT_TOTAL_TIME_ENABLED
+			| PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		long fd = syscall(SYS_perf_event_open, &attr, pid, -1, leader_,
+		                  PERF_FLAG_FD_CLOEXEC);
+
+		// Events that don't exist here, or that wouldn't fit on the PMU
+		// alongside the rest of the group, aren't counted.
+		fds_.push_back(static_cast<int>(fd));
+
+		if (leader_ < 0 and fd >= 0)
+			leader_ = static_cast<int>(fd);
+	}
+}
+
+
+EventCounters::~EventCounters()
+{
+	for (int fd : fds_)
+	{
+		if (fd >= 0)
+			close(fd);
+	}
+}
+
+
+EventCounts EventCounters::read() const
+{
+	constexpr size_t EventCount = sizeof(Events) / sizeof(Events[0]);
+
+	EventCounts events;
+	long long counts[EventCount];
+	std::fill(counts, counts + EventCount, -1);
+
+	// PERF_FORMAT_GROUP: { nr, time_enabled, time_running, values[nr] },
+	// with the leader's value first and then the others' in the order
+	// that they joined the group.
+	uint64_t group[3 + EventCount];
+	const ssize_t bytes =
+		leader_ < 0 ? -1 : ::read(leader_, group, sizeof(group));
+
+	// If other events (e.g., another test's counters) needed the PMU,
+	// the group was only counting some of the time: scale its counts up
+	// to estimate what a full run would have counted. A group that never
+	// got to count at all can't tell us anything.
+	if (bytes >= static_cast<ssize_t>(3 * sizeof(uint64_t))
+	    and group[0] <= EventCount
+	    and bytes == static_cast<ssize_t>((3 + group[0]) * sizeof(uint64_t))
+	    and group[2] > 0)
+	{
+		const uint64_t enabled = group[1], running = group[2];
+		const double scale = static_cast<double>(enabled) / running;
+		events.multiplexed = (running < enabled);
+
+		size_t next = 0;
+		for (size_t i = 0; i < fds_.size() and next < group[0]; i++)
+		{
+			if (fds_[i] < 0)
+				continue;
+
+			const uint64_t value = group[3 + next++];
+			counts[i] = events.multiplexed
+				? std::llround(value * scale)
+				: static_cast<long long>(value);
+		}
+	}
+
+	events.instructions = counts[0];
+	events.cycles = counts[1];
+	events.cacheMisses = counts[2];
+	events.branchMisses = counts[3];
+	events.taskClock = counts[4];
+	events.pageFaults = counts[5];
+
+	return events;
+}
+
+
+void grading::EnterSandbox()
+{
+	if (filteredProcess == getpid())
+		return;
+
+	// Test processes set up their own namespaces (unless a fork server
+	// that they came from already has), leaving the test suite's alone.
+	EnterSandboxNamespaces();
+
+#ifdef SANDBOX_AUDIT_ARCH
+	static_assert(sizeof(AllowedSyscalls) / sizeof(int) < 250,
+	              "BPF conditional jumps can only skip 255 instructions");
+
+	// A test run outside of a test suite has to build its own filter.
+	if (filter.empty())
+		BuildFilter();
+
+	// The filter only lets us signal ourselves: fill in who we are.
+	const __u32 self = static_cast<__u32>(getpid());
+	for (size_t i : processChecks)
+	{
+		filter[i].k = self;
+	}
+
+	struct sock_fprog prog;
+	prog.len = static_cast<unsigned short>(filter.size());
+	prog.filter = filter.data();
+
+	if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) != 0
+	    or prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, &prog) != 0)
+	{
+		err(EX_OSERR, "Error installing seccomp filter");
+	}
+#endif
+
+	filteredProcess = getpid();
+}
@@ -0,0 +1,284 @@
+/*!
+ * @file      newdelete.cpp
+ * @brief     @internal Replacement global operator new and operator delete
+ *            that count tests' allocations (the grading-allocations
+ *            library).
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#elif defined(__FreeBSD__)
+#include <malloc_np.h>
+#else
+#include <malloc.h>
+#endif
+
+using namespace grading;
+
+
+namespace {
+
+//! The size of a block that malloc(3) returned [B].
+long long BlockSize(void *p)
+{
+#if defined(__APPLE__)
+	return static_cast<long long>(malloc_size(p));
+#else
+	return static_cast<long long>(malloc_usable_size(p));
+#endif
+}
+
+
+//! Count an allocation (if a test is tracking them).
+void Allocated(void *p, size_t requested)
+{
+	AllocationCounters *c =
+		trackedAllocations.load(std::memory_order_relaxed);
+	if (not c)
+		return;
+
+	c->allocations++;
+	c->bytes += requested;
+	c->liveBlocks++;
+
+	const long long live = (c->liveBytes += BlockSize(p));
+	long long peak = c->peakBytes.load();
+	while (live > peak and not c->peakBytes.compare_exchange_weak(peak, live))
+	{
+	}
+}
+
+
+//! Count a deallocation (if a test is tracking them).
+void Deallocated(void *p)
+{
+	AllocationCounters *c =
+		trackedAllocations.load(std::memory_order_relaxed);
+	if (not c or not p)
+		return;
+
+	c->deallocations++;
+	c->liveBlocks--;
+	c->liveBytes -= BlockSize(p);
+}
+
+
+//! Allocate memory as the standard operator new does.
+void* Allocate(size_t size)
+{
+	if (size == 0)
+		size = 1;
+
+	void *p;
+	while ((p = malloc(size)) == nullptr)
+	{
+		std::new_handler handler = std::get_new_handler();
+		if (not handler)
+			throw std::bad_alloc();
+
+		handler();
+	}
+
+	Allocated(p, size);
+	return p;
+}
+
+
+void* AllocateNoThrow(size_t size) noexcept
+{
+	try
+	{
+		return Allocate(size);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+
+
+#ifdef __cpp_aligned_new
+//! Allocate over-aligned memory as the standard operator new does.
+void* Allocate(size_t size, std::align_val_t alignment)
+{
+	if (size == 0)
+		size = 1;
+
+	// posix_memalign(3) requires at least pointer alignment.
+	const size_t align =
+		std::max(static_cast<size_t>(alignment), sizeof(void*));
+
+	void *p;
+	while (posix_memalign(&p, align, size) != 0)
+	{
+		std::new_handler handler = std::get_new_handler();
+		if (not handler)
+			throw std::bad_alloc();
+
+		handler();
+	}
+
+	Allocated(p, size);
+	return p;
+}
+
+
+void* AllocateNoThrow(size_t size, std::align_val_t alignment) noexcept
+{
+	try
+	{
+		return Allocate(size, alignment);
+	}
+	catch (...)
+	{
+		return nullptr;
+	}
+}
+#endif
+
+
+void Deallocate(void *p) noexcept
+{
+	Deallocated(p);
+	free(p);
+}
+
+} // anonymous namespace
+
+
+//
+// Replacements for the standard library's allocation functions, which
+// every allocation in a program that links this library goes through.
+// They only count anything while a test is tracking its allocations.
+//
+void* operator new(size_t size)
+{
+	return Allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return Allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocateNoThrow(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return AllocateNoThrow(size);
+}
+
+void operator delete(void *p) noexcept
+{
+	Deallocate(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	Deallocate(p);
+}
+
+void operator delete(void *p, const std::nothrow_t&) noexcept
+{
+	Deallocate(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t&) noexcept
+{
+	Deallocate(p);
+}
+
+// Sized deallocation (C++14): what a block's size was doesn't matter to us.
+void operator delete(void *p, size_t) noexcept
+{
+	Deallocate(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	Deallocate(p);
+}
+
+#ifdef __cpp_aligned_new
+//
+// Over-aligned allocation (C++17): posix_memalign(3)'s blocks can be freed
+// like any other, so they share Deallocate() with the rest.
+//
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	return Allocate(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	return Allocate(size, alignment);
+}
+
+void* operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept
+{
+	return AllocateNoThrow(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept
+{
+	return AllocateNoThrow(size, alignment);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept
+{
+	Deallocate(p);
+}
+
+void operator delete[](void *p, std::align_val_t) noexcept
+{
+	Deallocate(p);
+}
+
+void operator delete(void *p, std::align_val_t,
+                     const std::nothrow_t&) noexcept
+{
+	Deallocate(p);
+}
+
+void operator delete[](void *p, std::align_val_t,
+                       const std::nothrow_t&) noexcept
+{
+	Deallocate(p);
+}
+
+void operator delete(void *p, size_t, std::align_val_t) noexcept
+{
+	Deallocate(p);
+}
+
+void operator delete[](void *p, size_t, std::align_val_t) noexcept
+{
+	Deallocate(p);
+}
+#endif
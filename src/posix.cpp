@@ -2,7 +2,9 @@
  * @file      posix.cpp
  * @brief     @internal POSIX implementation of
  *            @ref grading::CheckResult destructor,,
- *            @ref grading::MapSharedData, @ref grading::ForkTest and
+ *            @ref grading::MapSharedData, @ref grading::ForkChild,
+ *            @ref grading::StartTest, @ref grading::WaitForAny,
+ *            @ref grading::ForkTest and (except on Linux)
  *            @ref grading::EnterSandbox.
  *
  * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
@@ -23,18 +25,37 @@
 
 #include <libgrading.h>
 #include "private.h"
+#include "posix.h"
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <functional>
+#include <set>
 
 #include <sys/mman.h>
 #include <sys/wait.h>
 #include <err.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <signal.h>
 #include <unistd.h>
 
+#if defined(__linux__)
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#elif defined(__FreeBSD__)
+#include <sys/event.h>
+#include <sys/procctl.h>
+#elif defined(__APPLE__)
+#include <sys/event.h>
+#endif
+
+#if defined(__linux__) && !defined(MFD_CLOEXEC)
+#define MFD_CLOEXEC 0x0001U
+#endif
+
 using namespace grading;
 using namespace std;
 
@@ -63,7 +84,7 @@ CheckResult::~CheckResult()
 }
 
 
-static TestExitStatus ProcessChildStatus(int status)
+TestExitStatus grading::ProcessChildStatus(int status)
 {
 	if (WIFEXITED(status))
 		return static_cast<TestExitStatus>(WEXITSTATUS(status));
@@ -78,6 +99,12 @@ static TestExitStatus ProcessChildStatus(int status)
 			case SIGSEGV:
 			return TestExitStatus::Segfault;
 
+			case SIGXCPU:
+			return TestExitStatus::CpuLimit;
+
+			case SIGXFSZ:
+			return TestExitStatus::FileSizeLimit;
+
 			default:
 			return TestExitStatus::OtherError;
 		}
@@ -87,51 +114,204 @@ static TestExitStatus ProcessChildStatus(int status)
 }
 
 
+ResourceUsage grading::ConvertUsage(const struct rusage &ru)
+{
+	using std::chrono::microseconds;
+	using std::chrono::seconds;
+
+	ResourceUsage usage;
+	usage.userTime = seconds(ru.ru_utime.tv_sec)
+		+ microseconds(ru.ru_utime.tv_usec);
+	usage.systemTime = seconds(ru.ru_stime.tv_sec)
+		+ microseconds(ru.ru_stime.tv_usec);
+
+#if defined(__APPLE__)
+	// macOS reports ru_maxrss in bytes rather than KiB.
+	usage.maxResidentKiB = ru.ru_maxrss / 1024;
+#else
+	usage.maxResidentKiB = ru.ru_maxrss;
+#endif
+
+	usage.minorFaults = ru.ru_minflt;
+	usage.majorFaults = ru.ru_majflt;
+	usage.voluntarySwitches = ru.ru_nvcsw;
+	usage.involuntarySwitches = ru.ru_nivcsw;
+
+	return usage;
+}
+
 
 /**
- * @brief A memory-mapped POSIX shared memory segment.
+ * Set a resource limit on the current process.
+ *
+ * A limit of RLIM_INFINITY lifts the soft limit as far as the hard limit
+ * allows. We never try to raise a hard limit (which would fail).
+ *
+ * @param   resource   e.g., RLIMIT_AS
+ * @param   soft       the limit that the process will run into
+ * @param   hard       the hard limit to set (if setHard)
  */
-class PosixSharedMemory : public SharedMemory
+static bool SetLimit(int resource, rlim_t soft, bool setHard, rlim_t hard)
 {
-	public:
-	/**
-	 * Constructor.
-	 *
-	 * @param   fd       descriptor of (existing) shared memory segment
-	 * @param   len      size of the shared memory [B]
-	 * @param   rawPtr   pointer to the mmap'ed region
-	 */
-	PosixSharedMemory(int fd, size_t len, void *rawPtr)
-		: shmfd(fd), length(len), ptr(rawPtr)
+	struct rlimit rl;
+	if (getrlimit(resource, &rl) != 0)
 	{
+		return false;
 	}
 
-	~PosixSharedMemory()
+	if (rl.rlim_max != RLIM_INFINITY)
 	{
-		munmap(ptr, length);
-		close(shmfd);
+		soft = (soft == RLIM_INFINITY) ? rl.rlim_max
+		                               : std::min(soft, rl.rlim_max);
+		hard = (hard == RLIM_INFINITY) ? rl.rlim_max
+		                               : std::min(hard, rl.rlim_max);
 	}
 
-	//! Retrieve shared memory's file descriptor (POSIX-specific)
-	int fd() const { return shmfd; }
-	virtual void *rawPointer() const override { return ptr; }
+	rl.rlim_cur = soft;
+	if (setHard)
+	{
+		rl.rlim_max = hard;
+	}
 
-	private:
-	int shmfd;
-	size_t length;
-	void *ptr;
-};
+	return setrlimit(resource, &rl) == 0;
+}
 
 
-unique_ptr<SharedMemory> grading::MapSharedData(size_t len)
+bool grading::ApplyResourceLimits(const ChildLimits &limits, bool hard)
+{
+	const ResourceLimits &r = limits.resources;
+
+	// Convert "0 = no limit" into rlimit terms.
+	auto limit = [](size_t x) -> rlim_t
+	{
+		return (x == 0) ? RLIM_INFINITY : static_cast<rlim_t>(x);
+	};
+
+	rlim_t cpu = limit(static_cast<size_t>(r.cpuTime.count()));
+	if (cpu != RLIM_INFINITY and not hard)
+	{
+		// RLIMIT_CPU counts all of the CPU time the process has used,
+		// including time spent on earlier tests.
+		struct rusage ru;
+		if (getrusage(RUSAGE_SELF, &ru) == 0)
+		{
+			cpu += static_cast<rlim_t>(ru.ru_utime.tv_sec
+				+ ru.ru_stime.tv_sec + 1);
+		}
+	}
+
+	// With soft limits only, a limit of zero must lift earlier tests' limits.
+	// With hard limits, leave the inherited ones alone.
+	bool ok = true;
+	auto apply = [&](int resource, rlim_t value, rlim_t hardValue)
+	{
+		if (value == RLIM_INFINITY and hard)
+			return;
+
+		ok = SetLimit(resource, value, hard, hardValue) and ok;
+	};
+
+	apply(RLIMIT_AS, limit(r.memory), limit(r.memory));
+	apply(RLIMIT_DATA, limit(r.memory), limit(r.memory));
+	apply(RLIMIT_FSIZE, limit(r.fileSize), limit(r.fileSize));
+	apply(RLIMIT_NPROC, limit(r.processes), limit(r.processes));
+
+	// Deliver SIGXCPU at the soft limit; SIGKILL a second later if the
+	// test ignores it.
+	apply(RLIMIT_CPU, cpu, (cpu == RLIM_INFINITY) ? cpu : cpu + 1);
+
+	if (not limits.coreDumps)
+	{
+		ok = SetLimit(RLIMIT_CORE, 0, hard, 0) and ok;
+	}
+	else if (not hard)
+	{
+		ok = SetLimit(RLIMIT_CORE, RLIM_INFINITY, false, 0) and ok;
+	}
+
+	return ok;
+}
+
+
+//! The resources used by this process so far.
+static ResourceUsage SelfUsage()
+{
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) != 0)
+	{
+		return ResourceUsage();
+	}
+
+	return ConvertUsage(ru);
+}
+
+
+UsageMeter::UsageMeter()
+	: start_(std::chrono::steady_clock::now()), before_(SelfUsage())
+{
+}
+
+
+ResourceUsage UsageMeter::elapsed() const
+{
+	ResourceUsage usage = SelfUsage();
+
+	usage.wallTime = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - start_);
+
+	usage.userTime -= before_.userTime;
+	usage.systemTime -= before_.systemTime;
+	usage.minorFaults -= before_.minorFaults;
+	usage.majorFaults -= before_.majorFaults;
+	usage.voluntarySwitches -= before_.voluntarySwitches;
+	usage.involuntarySwitches -= before_.involuntarySwitches;
+
+	// A process's peak RSS can't be apportioned between its tests.
+
+	return usage;
+}
+
+
+
+/**
+ * Create an anonymous shared memory object that leaves nothing behind
+ * in the filesystem.
+ *
+ * @returns   a file descriptor, or -1 on failure
+ */
+static int AnonymousSharedMemory()
 {
 #if defined (__BSD_VISIBLE)
-	int fd = shm_open(SHM_ANON, O_RDWR, 0600);
+	return shm_open(SHM_ANON, O_RDWR, 0600);
 #else
+
+#if defined(__linux__) && defined(SYS_memfd_create)
+	int memfd = static_cast<int>(
+		syscall(SYS_memfd_create, "libgrading", MFD_CLOEXEC));
+
+	// Older kernels lack memfd_create(2): fall back to a temporary file.
+	if (memfd >= 0 or errno != ENOSYS)
+	{
+		return memfd;
+	}
+#endif
+
+	// Unlink the file right away: the descriptor keeps it alive.
 	char tmpnameTemplate[] = "/tmp/libgrading.XXXXXX";
 	int fd = mkstemp(tmpnameTemplate);
+	if (fd >= 0)
+	{
+		unlink(tmpnameTemplate);
+	}
+
+	return fd;
 #endif
+}
+
 
+unique_ptr<SharedMemory> grading::MapSharedData(size_t len)
+{
+	int fd = AnonymousSharedMemory();
 	if (fd < 0)
 	{
 		return nullptr;
@@ -146,6 +326,7 @@ unique_ptr<SharedMemory> grading::MapSharedData(size_t len)
 	void *map = mmap(0, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 	if (map == MAP_FAILED)
 	{
+		close(fd);
 		return nullptr;
 	}
 
@@ -153,8 +334,319 @@ unique_ptr<SharedMemory> grading::MapSharedData(size_t len)
 }
 
 
-TestResult grading::ForkTest(TestClosure test, time_t timeout)
+/**
+ * Get a descriptor that will become readable when a child process exits.
+ *
+ * On Linux this is a process descriptor (pidfd); on FreeBSD and macOS it is
+ * a kqueue watching for NOTE_EXIT. Both can be passed to poll(2).
+ *
+ * @returns   a pollable descriptor, or -1 if not supported
+ */
+static int WatchForExit(pid_t pid)
+{
+#if defined(__linux__) && defined(SYS_pidfd_open)
+	return static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+
+#elif defined(__FreeBSD__) || defined(__APPLE__)
+	int kq = kqueue();
+	if (kq < 0)
+	{
+		return -1;
+	}
+
+	struct kevent ev;
+	EV_SET(&ev, pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0,
+	       nullptr);
+
+	// ESRCH means the child has already exited: waitpid() won't block.
+	if (kevent(kq, &ev, 1, nullptr, 0, nullptr) != 0)
+	{
+		close(kq);
+		return -1;
+	}
+
+	return kq;
+
+#else
+	return -1;
+#endif
+}
+
+
+PosixChildTest::PosixChildTest(pid_t pid, unique_ptr<OutputCapture> out,
+                               unique_ptr<OutputCapture> err,
+                               const ChildLimits &limits, string scratch,
+                               unique_ptr<EventCounters> counters,
+                               unique_ptr<StackProfile> profile)
+	: child_(pid), exitfd_(WatchForExit(pid)),
+	  out_(std::move(out)), err_(std::move(err)), limits_(limits),
+	  started_(Clock::now()), deadline_(started_ + limits.timeout),
+	  finished_(false), killed_(false), killedFor_(TestExitStatus::Pass),
+	  status_(0), rusage_(), wallTime_(0), strays_(0),
+	  scratch_(std::move(scratch)), counters_(std::move(counters)),
+	  profile_(std::move(profile))
+{
+}
+
+
+PosixChildTest::~PosixChildTest()
+{
+	if (exitfd_ >= 0)
+		close(exitfd_);
+}
+
+
+void PosixChildTest::reap(int options)
+{
+	while (not finished_)
+	{
+		pid_t result = wait4(child_, &status_, options, &rusage_);
+
+		// Success: the child process has returned.
+		if (result == child_)
+		{
+			wallTime_ = Clock::now() - started_;
+			finished_ = true;
+			killStrays();
+
+			if (not scratch_.empty())
+				DiscardScratchDirectory(scratch_);
+
+			break;
+		}
+
+		// Error in wait4()?
+		if (result < 0)
+		{
+			assert(errno == EINTR);
+			continue;
+		}
+
+		// Child process isn't finished yet.
+		break;
+	}
+}
+
+
+void PosixChildTest::drain()
+{
+	// A child can write output as fast as we can read it: read a bounded
+	// amount at a time so that we still get to check its limits.
+	const size_t chunk = 64 * 1024;
+
+	out_->drain(chunk);
+	err_->drain(chunk);
+}
+
+
+void PosixChildTest::kill(TestExitStatus reason)
+{
+	// Kill the whole process group, not just the child.
+	::kill(-child_, SIGKILL);
+	reap(0);
+
+	killed_ = true;
+	killedFor_ = reason;
+}
+
+
+void PosixChildTest::killStrays()
+{
+	strays_ += KillProcessGroup(child_);
+}
+
+
+long grading::KillProcessGroup(pid_t pgid)
 {
+	long reaped = 0;
+
+	// kill(2) fails with ESRCH once nothing is left in the group.
+	while (::kill(-pgid, SIGKILL) == 0)
+	{
+		pid_t pid = waitpid(-pgid, nullptr, 0);
+
+		if (pid > 0)
+		{
+			reaped++;
+		}
+		else if (errno != EINTR)
+		{
+			// ECHILD: the rest of the group belongs to someone else.
+			break;
+		}
+	}
+
+	return reaped;
+}
+
+
+vector<int> PosixChildTest::pollfds() const
+{
+	vector<int> fds;
+
+	for (int fd : { exitfd_, out_->pollfd(), err_->pollfd() })
+	{
+		if (fd >= 0)
+			fds.push_back(fd);
+	}
+
+	return fds;
+}
+
+
+int PosixChildTest::msUntilDeadline() const
+{
+	// Without an exit descriptor, fall back to checking frequently.
+	const int maximum = (exitfd_ < 0) ? 1 : -1;
+
+	if (limits_.timeout == Timeout::zero())
+		return maximum;
+
+	const Clock::duration remaining = deadline_ - Clock::now();
+	if (remaining <= Clock::duration::zero())
+		return 0;
+
+	// Round up: waking before the deadline would only make us sleep again.
+	auto ms = std::chrono::duration_cast<Timeout>(remaining);
+	if (ms < remaining)
+		ms += Timeout(1);
+
+	const int count = static_cast<int>(ms.count());
+	return (maximum < 0) ? count : std::min(count, maximum);
+}
+
+
+bool PosixChildTest::done()
+{
+	if (finished_)
+		return true;
+
+	drain();
+	reap(WNOHANG);
+
+	// Collect anything written between our last drain and exit.
+	if (finished_)
+		drain();
+
+	if (limits_.outputLimit != 0
+	    and out_->total() + err_->total() > limits_.outputLimit)
+	{
+		// Once we've reaped the child, its PID may belong to someone else.
+		if (finished_)
+		{
+			killed_ = true;
+			killedFor_ = TestExitStatus::OutputLimit;
+		}
+		else
+		{
+			kill(TestExitStatus::OutputLimit);
+		}
+	}
+	else if (not finished_ and limits_.timeout != Timeout::zero()
+	         and Clock::now() >= deadline_)
+	{
+		kill(TestExitStatus::Timeout);
+	}
+
+	return finished_;
+}
+
+
+TestResult PosixChildTest::result()
+{
+	while (not done())
+	{
+		WaitForAny({ this });
+	}
+
+	ResourceUsage usage = ConvertUsage(rusage_);
+	usage.wallTime =
+		std::chrono::duration_cast<std::chrono::microseconds>(wallTime_);
+	usage.strayProcesses = strays_;
+
+	if (counters_)
+		usage.events = counters_->read();
+
+	const TestExitStatus status =
+		killed_ ? killedFor_ : ProcessChildStatus(status_);
+
+	string errors = err_->release();
+	if (profile_ and (status == TestExitStatus::Timeout
+	                  or status == TestExitStatus::CpuLimit))
+	{
+		if (not errors.empty())
+			errors += (errors.back() == '\n') ? "\n" : "\n\n";
+
+		errors += profile_->report();
+	}
+
+	return TestResult(status, out_->release(), std::move(errors), usage);
+}
+
+
+void grading::BecomeSubreaper()
+{
+	// This isn't inherited across fork(2): a fork server needs its own.
+	static pid_t subreaper = 0;
+	if (subreaper == getpid())
+		return;
+
+#if defined(__linux__) && defined(PR_SET_CHILD_SUBREAPER)
+	prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0);
+#elif defined(__FreeBSD__) && defined(PROC_REAP_ACQUIRE)
+	procctl(P_PID, getpid(), PROC_REAP_ACQUIRE, nullptr);
+#endif
+
+	subreaper = getpid();
+}
+
+
+namespace {
+
+//! Descriptors that tests shouldn't inherit (see @ref HideFromTests).
+std::set<int> hiddenDescriptors;
+
+} // anonymous namespace
+
+
+void grading::HideFromTests(int fd)
+{
+	hiddenDescriptors.insert(fd);
+}
+
+
+void grading::RevealToTests(int fd)
+{
+	hiddenDescriptors.erase(fd);
+}
+
+
+void grading::CloseHiddenDescriptors()
+{
+	for (int fd : hiddenDescriptors)
+	{
+		close(fd);
+	}
+
+	hiddenDescriptors.clear();
+}
+
+
+pid_t grading::ForkChild(const TestClosure &test, const ChildLimits &limits,
+                         const string &scratch, int out, int err,
+                         unique_ptr<EventCounters> &counters,
+                         const StackProfile *profile)
+{
+	BecomeSubreaper();
+
+	// The child waits for counters to be attached by reading from a pipe
+	// until we close the other end.
+	int ready[2] = { -1, -1 };
+	if (limits.countEvents and pipe(ready) != 0)
+	{
+		return -1;
+	}
+
 	std::cout.flush();
 	std::cerr.flush();
 	std::clog.flush();
@@ -162,79 +654,223 @@ TestResult grading::ForkTest(TestClosure test, time_t timeout)
 	fflush(stdout);
 	fflush(stderr);
 
-	auto out = MapSharedData(10 * 4096);
-	if (not out)
+	pid_t child = fork();
+
+	if (child == 0)
 	{
-		return TestExitStatus::OtherError;
+		// Lead a new process group, which we'll kill when we're done.
+		setpgid(0, 0);
+
+		// Don't let the test talk to the test suite (or its servers).
+		CloseHiddenDescriptors();
+
+		// Install capture pipes as stdout and stderr
+		if (dup2(out, STDOUT_FILENO) < 0 or dup2(err, STDERR_FILENO) < 0)
+		{
+			exit(static_cast<int>(TestExitStatus::OtherError));
+		}
+
+		close(out);
+		close(err);
+
+		if (not scratch.empty() and not EnterScratchDirectory(scratch))
+		{
+			exit(static_cast<int>(TestExitStatus::OtherError));
+		}
+
+		if (not ApplyResourceLimits(limits, true))
+		{
+			exit(static_cast<int>(TestExitStatus::OtherError));
+		}
+
+		if (ready[0] >= 0)
+		{
+			char c;
+			close(ready[1]);
+
+			while (read(ready[0], &c, 1) < 0 and errno == EINTR)
+			{
+			}
+
+			close(ready[0]);
+		}
+
+		if (profile)
+			profile->start();
+
+		TestExitStatus status = RunInProcess(test, limits);
+		exit(static_cast<int>(status));
 	}
 
-	auto err = MapSharedData(10 * 4096);
-	if (not err)
+	// Also set the group from the parent: we may signal it before the
+	// child gets around to it.
+	if (child > 0)
+		setpgid(child, child);
+
+	if (ready[0] >= 0)
 	{
-		return TestExitStatus::OtherError;
+		close(ready[0]);
+
+		if (child > 0)
+			counters.reset(new EventCounters(child));
+
+		close(ready[1]);
 	}
 
+	return child;
+}
+
+
+bool grading::RunIsolated(const TestClosure &code)
+{
+	// Don't let the child flush output that we have buffered (again).
+	cout.flush();
+	cerr.flush();
+	fflush(nullptr);
+
 	pid_t child = fork();
+	if (child < 0)
+		return false;
 
 	if (child == 0)
 	{
-		// Install shared file(s) as stdout and stderr
-		int fd = dynamic_cast<const PosixSharedMemory&>(*out).fd();
-		if (fd < 0 or dup2(fd, STDOUT_FILENO) < 0)
+		int status = 0;
+
+		try
 		{
-			return TestExitStatus::OtherError;
+			code();
 		}
-
-		fd = dynamic_cast<const PosixSharedMemory&>(*err).fd();
-		if (fd < 0 or dup2(fd, STDERR_FILENO) < 0)
+		catch (...)
 		{
-			return TestExitStatus::OtherError;
+			status = 1;
 		}
 
-		TestExitStatus status = RunInProcess(test);
-		exit(static_cast<int>(status));
+		cout.flush();
+		cerr.flush();
+		fflush(nullptr);
+		_exit(status);
 	}
-	else
+
+	int status;
+	while (waitpid(child, &status, 0) < 0)
 	{
-		int status;
-		int options = (timeout ? WNOHANG : 0);
+		if (errno != EINTR)
+			return false;
+	}
+
+	return WIFEXITED(status) and WEXITSTATUS(status) == 0;
+}
 
-		time_t start = time(nullptr);
 
-		while (true)
+long long grading::CountInstructions(const TestClosure &code)
+{
+	EventCounters counters(0);
+	code();
+
+	return counters.read().instructions;
+}
+
+
+unique_ptr<ChildTest> grading::StartTest(TestClosure test,
+                                         const ChildLimits &limits)
+{
+	unique_ptr<OutputCapture> out(
+		new OutputCapture(limits.outputHead, limits.outputTail));
+
+	unique_ptr<OutputCapture> err(
+		new OutputCapture(limits.outputHead, limits.outputTail));
+
+	if (not out->open() or not err->open())
+	{
+		return nullptr;
+	}
+
+	string scratch;
+	if (limits.scratchDirectory)
+	{
+		scratch = CreateScratchDirectory(true);
+		if (scratch.empty())
 		{
-			pid_t result = waitpid(child, &status, options);
+			return nullptr;
+		}
+	}
 
-			// Success: the child process has returned.
-			if (result == child)
-				break;
+	unique_ptr<StackProfile> profile;
+	if (limits.profile)
+		profile.reset(new StackProfile);
 
-			// Error in waitpid()?
-			if (result < 0)
-			{
-				assert(errno == EINTR);
-				continue;
-			}
+	unique_ptr<EventCounters> counters;
+	pid_t child = ForkChild(test, limits, scratch, out->writeEnd(),
+	                        err->writeEnd(), counters, profile.get());
+	if (child < 0)
+	{
+		if (not scratch.empty())
+			DiscardScratchDirectory(scratch);
 
-			// Child process isn't finished yet.
-			const time_t now = time(nullptr);
-			if ((now - start) > timeout)
-			{
-				kill(child, SIGKILL);
-				waitpid(child, &status, 0);
-				return TestExitStatus::Timeout;
-			}
+		return nullptr;
+	}
 
-			usleep(100);
+	out->closeWriteEnd();
+	err->closeWriteEnd();
+
+	return unique_ptr<ChildTest>(
+		new PosixChildTest(child, std::move(out), std::move(err),
+		                   limits, std::move(scratch),
+		                   std::move(counters), std::move(profile)));
+}
+
+
+void grading::WaitForAny(const vector<ChildTest*>& tests)
+{
+	if (tests.empty())
+		return;
+
+	vector<struct pollfd> fds;
+	int timeout = -1;
+
+	for (ChildTest *t : tests)
+	{
+		if (t->done())
+			return;
+
+		auto &child = dynamic_cast<const PollableTest&>(*t);
+
+		// Sleep no later than the earliest deadline.
+		const int ms = child.msUntilDeadline();
+		if (ms >= 0 and (timeout < 0 or ms < timeout))
+			timeout = ms;
+
+		for (int fd : child.pollfds())
+		{
+			struct pollfd pfd;
+			pfd.fd = fd;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+			fds.push_back(pfd);
 		}
+	}
 
-		return TestResult(ProcessChildStatus(status),
-			string(static_cast<char*>(out->rawPointer())),
-			string(static_cast<char*>(err->rawPointer())));
+	// Sleep until a child needs attention or a deadline passes. Either
+	// way, the caller will check done() on each test to see what happened.
+	if (poll(fds.data(), fds.size(), timeout) < 0)
+	{
+		assert(errno == EINTR);
 	}
 }
 
 
+TestResult grading::ForkTest(TestClosure test, const ChildLimits &limits)
+{
+	unique_ptr<ChildTest> child = StartTest(test, limits);
+	if (not child)
+	{
+		return TestExitStatus::OtherError;
+	}
+
+	return child->result();
+}
+
+
 #ifdef __FreeBSD__
 #include <sys/param.h>
 
@@ -248,14 +884,79 @@ TestResult grading::ForkTest(TestClosure test, time_t timeout)
 #include <errno.h>
 #include <sysexits.h>
 
+void grading::PrepareSandbox()
+{
+}
+
+void grading::EnterSandboxNamespaces()
+{
+}
+
+bool grading::PrivateMountsAvailable()
+{
+	return false;
+}
+
+bool grading::MountPrivateTmpfs(const string&)
+{
+	return false;
+}
+
+EventCounters::EventCounters(pid_t)
+	: leader_(-1)
+{
+}
+
+EventCounters::~EventCounters()
+{
+}
+
+EventCounts EventCounters::read() const
+{
+	return EventCounts();
+}
+
 void grading::EnterSandbox()
 {
 	if ((cap_enter() != 0) and (errno != ENOSYS))
 		err(EX_OSERR, "Error in cap_enter()");
 }
-#else
+
+#elif !defined(__linux__)   // see linux.cpp
 
 #warning EnterSandbox() does nothing on the current platform
+void grading::PrepareSandbox()
+{
+}
+
+void grading::EnterSandboxNamespaces()
+{
+}
+
+bool grading::PrivateMountsAvailable()
+{
+	return false;
+}
+
+bool grading::MountPrivateTmpfs(const string&)
+{
+	return false;
+}
+
+EventCounters::EventCounters(pid_t)
+	: leader_(-1)
+{
+}
+
+EventCounters::~EventCounters()
+{
+}
+
+EventCounts EventCounters::read() const
+{
+	return EventCounts();
+}
+
 void grading::EnterSandbox()
 {
 }
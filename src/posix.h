@@ -0,0 +1,399 @@
+/*!
+ * @file      posix.h
+ * @brief     @internal Internal declarations shared by POSIX sources.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2014-2015, 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef LIBGRADING_POSIX_H
+#define LIBGRADING_POSIX_H
+
+#include "private.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+
+namespace grading {
+
+
+/**
+ * @brief A memory-mapped POSIX shared memory segment.
+ */
+class PosixSharedMemory : public SharedMemory
+{
+	public:
+	/**
+	 * Constructor.
+	 *
+	 * @param   fd       descriptor of (existing) shared memory segment
+	 * @param   len      size of the shared memory [B]
+	 * @param   rawPtr   pointer to the mmap'ed region
+	 */
+	PosixSharedMemory(int fd, size_t len, void *rawPtr)
+		: shmfd(fd), length(len), ptr(rawPtr)
+	{
+	}
+
+	~PosixSharedMemory()
+	{
+		munmap(ptr, length);
+		close(shmfd);
+	}
+
+	//! Retrieve shared memory's file descriptor (POSIX-specific)
+	int fd() const { return shmfd; }
+	virtual void *rawPointer() const override { return ptr; }
+	virtual size_t size() const override { return length; }
+
+	private:
+	int shmfd;
+	size_t length;
+	void *ptr;
+};
+
+
+/**
+ * @brief Output captured from one of a child's streams via a pipe.
+ *
+ * The parent drains the pipe while the child runs, retaining only the
+ * beginning and end of the output but counting every byte.
+ */
+class OutputCapture
+{
+	public:
+	/**
+	 * Constructor.
+	 *
+	 * @param   head     how many bytes to keep from the start of the output
+	 * @param   tail     how many bytes to keep from the end of the output
+	 */
+	OutputCapture(size_t head, size_t tail);
+	~OutputCapture();
+
+	OutputCapture(const OutputCapture&) = delete;
+
+	//! Create the pipe that the child will write to.
+	bool open();
+
+	//! The end of the pipe that the child should write to.
+	int writeEnd() const { return write_; }
+
+	//! Close our copy of the write end (once the child has its own).
+	void closeWriteEnd();
+
+	//! Keep the read end away from tests (see @ref HideFromTests).
+	void hideFromTests();
+
+	//! A descriptor to poll for more output (-1 once the pipe is closed).
+	int pollfd() const { return eof_ ? -1 : read_; }
+
+	/**
+	 * Read currently-available output without blocking.
+	 *
+	 * @param   maximum   stop after reading about this many bytes
+	 *                    (0 = read until the pipe is empty)
+	 */
+	void drain(size_t maximum = 0);
+
+	//! The total number of bytes written by the child.
+	size_t total() const { return total_; }
+
+	/**
+	 * Hand over the retained output, noting how many bytes (if any) were
+	 * omitted. This leaves the capture empty until it is @ref clear'ed.
+	 */
+	std::string release();
+
+	//! Discard captured output (e.g., between batched tests).
+	void clear(size_t head, size_t tail);
+
+	private:
+	int read_;
+	int write_;
+	bool eof_;
+	bool hidden_;
+
+	size_t head_;
+	size_t tail_;
+
+	std::string headBuffer_;
+	std::vector<char> tailBuffer_;   //!< ring buffer
+	size_t tailStart_;
+	size_t tailLength_;
+	size_t total_;
+};
+
+
+/**
+ * @brief Performance counters attached to a child process.
+ *
+ * The counters are inherited by the child's own children, whose events
+ * are added to the child's when they exit.
+ */
+class EventCounters
+{
+	public:
+	/**
+	 * Open counters for a process (which shouldn't have started its
+	 * test yet) or, given 0, for this process from now on, as one group
+	 * that counts together. Events that can't be counted are skipped.
+	 */
+	EventCounters(pid_t);
+	~EventCounters();
+
+	EventCounters(const EventCounters&) = delete;
+
+	//! Read the counts (once the process, or the counted code, has finished).
+	EventCounts read() const;
+
+	private:
+	std::vector<int> fds_;     //!< one per event (-1 if not counted)
+	int leader_;               //!< the group's leader (-1 if none)
+};
+
+
+/**
+ * @brief A histogram of a test's stacks, sampled with `SIGPROF`.
+ *
+ * The histogram is kept in shared memory: the test's process samples its
+ * own stack and the process that started the test summarizes the hottest
+ * functions (see @ref TestBuilder::profile).
+ */
+class StackProfile
+{
+	public:
+	/**
+	 * Map an empty histogram (before forking the test's process).
+	 *
+	 * Each profile has a histogram of its own: stray processes from an
+	 * earlier test may still be sampling into theirs.
+	 */
+	StackProfile();
+
+	//! Start sampling the calling process (i.e., the test's process).
+	void start() const;
+
+	//! Describe the functions that were sampled most often.
+	std::string report() const;
+
+	private:
+	std::unique_ptr<SharedMemory> samples_;
+};
+
+
+/**
+ * @brief A @ref ChildTest that can be waited for with poll(2).
+ */
+class PollableTest : public ChildTest
+{
+	public:
+	//! Descriptors that become readable when the test needs attention.
+	virtual std::vector<int> pollfds() const = 0;
+
+	/**
+	 * How long we can sleep before this test must be checked again
+	 * (e.g., because its timeout will expire).
+	 *
+	 * @returns   time remaining [ms], or -1 if there is no deadline
+	 */
+	virtual int msUntilDeadline() const = 0;
+};
+
+
+/**
+ * @brief A test running in a forked POSIX child process.
+ */
+class PosixChildTest : public PollableTest
+{
+	//! Monotonic clock used to enforce timeouts.
+	typedef std::chrono::steady_clock Clock;
+
+	public:
+	/**
+	 * Constructor.
+	 *
+	 * @param   pid      the child process running the test
+	 * @param   out      capture of the child's stdout
+	 * @param   err      capture of the child's stderr
+	 * @param   limits   limits on the child (e.g., timeout)
+	 * @param   scratch  the child's scratch directory (if any)
+	 * @param   counters performance counters attached to the child
+	 * @param   profile  the child's stack samples (if it is profiled)
+	 */
+	PosixChildTest(pid_t pid, std::unique_ptr<OutputCapture> out,
+	               std::unique_ptr<OutputCapture> err, const ChildLimits&,
+	               std::string scratch,
+	               std::unique_ptr<EventCounters> counters,
+	               std::unique_ptr<StackProfile> profile);
+
+	~PosixChildTest();
+
+	virtual bool done() override;
+	virtual TestResult result() override;
+
+	virtual std::vector<int> pollfds() const override;
+	virtual int msUntilDeadline() const override;
+
+	private:
+	//! Collect the child's exit status if it has finished.
+	void reap(int options);
+
+	//! Read a bounded amount of output from the child.
+	void drain();
+
+	//! Kill the child, reporting the given status instead of its own.
+	void kill(TestExitStatus);
+
+	//! Kill and reap whatever is left of the child's process group.
+	void killStrays();
+
+	const pid_t child_;
+	const int exitfd_;
+	const std::unique_ptr<OutputCapture> out_;
+	const std::unique_ptr<OutputCapture> err_;
+	const ChildLimits limits_;
+	const Clock::time_point started_;
+	const Clock::time_point deadline_;
+
+	bool finished_;
+	bool killed_;
+	TestExitStatus killedFor_;
+	int status_;
+	struct rusage rusage_;     //!< from wait4(2), once finished
+	Clock::duration wallTime_;
+	long strays_;              //!< stray processes killed by killStrays()
+	std::string scratch_;      //!< scratch directory (if any)
+	std::unique_ptr<EventCounters> counters_;
+	std::unique_ptr<StackProfile> profile_;
+};
+
+
+//! Convert a child's wait(2) status into a @ref TestExitStatus.
+TestExitStatus ProcessChildStatus(int status);
+
+//! Convert getrusage(2) or wait4(2) accounting into a @ref ResourceUsage.
+ResourceUsage ConvertUsage(const struct rusage&);
+
+/**
+ * Become a "subreaper": inherit our children's orphaned descendants
+ * (rather than having them reparented to init) so that we can reap them.
+ *
+ * This is a no-op on platforms without subreapers.
+ */
+void BecomeSubreaper();
+
+/**
+ * Kill every process in a process group, reaping any that are our children.
+ *
+ * Orphaned descendants of a test are reparented to the test suite (see
+ * @ref ForkChild), so we can reap and count them.
+ *
+ * @returns   the number of processes reaped
+ */
+long KillProcessGroup(pid_t pgid);
+
+/**
+ * Keep a descriptor away from tests (e.g., a test server's socket).
+ *
+ * Processes forked by @ref ForkChild close every hidden descriptor before
+ * they do anything else, as do newly-spawned test servers.
+ */
+void HideFromTests(int fd);
+
+//! Stop hiding a descriptor (before closing it).
+void RevealToTests(int fd);
+
+//! Close all hidden descriptors (in a newly-forked child).
+void CloseHiddenDescriptors();
+
+/**
+ * Can tests mount private filesystems (e.g., in a Linux mount namespace)?
+ */
+bool PrivateMountsAvailable();
+
+/**
+ * Mount a private tmpfs over a directory, visible only to this process
+ * and its descendants. It will be unmounted when they have all exited.
+ */
+bool MountPrivateTmpfs(const std::string &dir);
+
+/**
+ * Create a scratch directory for a test (in the test suite's process).
+ *
+ * @param   privateMount   whether the test runs in a process of its own
+ *                         that can mount a private tmpfs over the directory
+ *
+ * @returns   the directory's path, or an empty string on failure
+ */
+std::string CreateScratchDirectory(bool privateMount);
+
+/**
+ * Make a scratch directory the working directory (in the test's process),
+ * mounting a tmpfs over it if it was created for one.
+ */
+bool EnterScratchDirectory(const std::string&);
+
+/**
+ * Dispose of a test's scratch directory once the test has finished.
+ *
+ * This doesn't wait for the directory's contents to be deleted.
+ */
+void DiscardScratchDirectory(const std::string&);
+
+/**
+ * Apply a test's resource limits to the current process.
+ *
+ * @param   limits   the limits to apply
+ * @param   hard     also set hard limits so that the test can't raise them;
+ *                   otherwise only soft limits are set, so that a process
+ *                   that runs several tests can change them between tests
+ *
+ * @returns   whether all of the limits could be applied
+ */
+bool ApplyResourceLimits(const ChildLimits &limits, bool hard);
+
+
+/**
+ * Fork a child process that runs a test, with its stdout and stderr
+ * redirected to the given descriptors.
+ *
+ * If @a limits ask for events to be counted, the child waits until we have
+ * attached @a counters to it before it starts the test. If @a profile isn't
+ * null, the child starts sampling its stack just before the test starts.
+ *
+ * The child leads a new process group so that it can be killed along with
+ * anything that it forks. Where supported, the calling process becomes a
+ * "subreaper" that inherits the child's orphaned descendants.
+ *
+ * If @a scratch isn't empty, the child runs the test within that scratch
+ * directory (see @ref EnterScratchDirectory).
+ *
+ * @returns   the child's PID in the parent, or -1 on error
+ */
+pid_t ForkChild(const TestClosure&, const ChildLimits&,
+                const std::string &scratch, int out, int err,
+                std::unique_ptr<EventCounters> &counters,
+                const StackProfile *profile);
+
+} // namespace grading
+
+#endif
@@ -23,6 +23,12 @@
 
 #include <libgrading.h>
 
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <unordered_map>
+
 
 namespace grading {
 
@@ -33,6 +39,136 @@ enum class OutputFormat : char
 	Brief,               //!< default (brief) output
 	Gradescope,          //!< Gradescope JSON
 	Verbose,             //!< verbose: full detail, text separators, etc.
+	Results,             //!< results that can be merged with other shards'
+};
+
+
+/**
+ * Limits imposed on a test that runs in a child process.
+ */
+struct ChildLimits
+{
+	//! Default limits: no timeout, 16 MiB of output, no core dumps.
+	ChildLimits();
+
+	//! How long the test may run (0 = forever).
+	Timeout timeout;
+
+	//! Kill the test once it writes more than this [B] (0 = no limit).
+	size_t outputLimit;
+
+	//! How much output to keep from the start of each stream [B].
+	size_t outputHead;
+
+	//! How much output to keep from the end of each stream [B].
+	size_t outputTail;
+
+	//! Operating system resource limits (memory, CPU time, etc.).
+	ResourceLimits resources;
+
+	//! Allow tests to write core dumps when they crash.
+	bool coreDumps;
+
+	//! Run each test in an empty scratch directory of its own.
+	bool scratchDirectory;
+
+	//! Count hardware and software events while each test runs.
+	bool countEvents;
+
+	//! Sample tests' stacks, reporting hot functions if they're too slow.
+	bool profile;
+};
+
+
+/**
+ * Which of a suite's tests to run (by default, all of them).
+ */
+struct TestFilter
+{
+	TestFilter() : shard(0), shards(1) {}
+
+	//! Only run tests whose names match one of these globs (if any).
+	std::vector<std::string> names;
+
+	//! Only run tests with at least one of these tags (if any).
+	std::vector<std::string> tags;
+
+	//! Don't run tests with any of these tags.
+	std::vector<std::string> excludedTags;
+
+	//! Which shard of the (selected) tests to run, counting from 0.
+	unsigned int shard;
+
+	//! How many shards to divide the tests into.
+	unsigned int shards;
+
+	//! Does this filter select every test?
+	bool empty() const
+	{
+		return names.empty() and tags.empty() and excludedTags.empty()
+			and shards == 1;
+	}
+};
+
+
+/**
+ * Where to cache test results, and what to key them by.
+ */
+struct CacheOptions
+{
+	//! Directory to keep cached results in (empty: no caching).
+	std::string directory;
+
+	//! Identifies the code under test (empty: hash the executable).
+	std::string submission;
+};
+
+
+/**
+ * Where to journal test results, and whether to resume from the journal.
+ */
+struct JournalOptions
+{
+	JournalOptions() : resume(false) {}
+
+	//! File to append results to (empty: no journal).
+	std::string filename;
+
+	//! Report results already in the journal instead of re-running tests.
+	bool resume;
+};
+
+
+/**
+ * Where to remember tests' durations, and whether to use them for scheduling.
+ */
+struct HistoryOptions
+{
+	HistoryOptions() : suiteOrder(false) {}
+
+	//! File to keep tests' durations in (empty: no history).
+	std::string filename;
+
+	//! Start tests in suite order rather than longest-first.
+	bool suiteOrder;
+};
+
+
+/**
+ * How to calibrate tests' timeouts, or which calibrated timeouts to use.
+ */
+struct CalibrationOptions
+{
+	CalibrationOptions() : runs(5) {}
+
+	//! File to write a timeout profile to (empty: don't calibrate).
+	std::string output;
+
+	//! How many times to run the suite when calibrating.
+	unsigned int runs;
+
+	//! Timeout profile to apply (empty: use tests' own timeouts).
+	std::string profile;
 };
 
 
@@ -49,7 +185,9 @@ struct Arguments
 
 	//! Normal Arguments constructor
 	Arguments(bool error, bool help, OutputFormat, bool skip,
-	          TestRunStrategy, time_t timeout);
+	          TestRunStrategy, ChildLimits, unsigned int jobs,
+	          TestFilter, std::vector<std::string> merge, CacheOptions,
+	          JournalOptions, HistoryOptions, CalibrationOptions);
 
 	//! There was an error parsing command-line arguments.
 	const bool error;
@@ -66,8 +204,29 @@ struct Arguments
 	//! The @ref TestRunStrategy chosen by the user (e.g., inline).
 	const TestRunStrategy runStrategy;
 
-	//! Maximum length of time to wait for any test.
-	const time_t timeout;
+	//! Limits to apply to every test (e.g., maximum time to wait).
+	const ChildLimits limits;
+
+	//! Maximum number of tests to run concurrently.
+	const unsigned int jobs;
+
+	//! Which tests to run.
+	const TestFilter filter;
+
+	//! Shards' result files to merge (instead of running tests).
+	const std::vector<std::string> merge;
+
+	//! Where to cache test results.
+	const CacheOptions cache;
+
+	//! Where to journal test results.
+	const JournalOptions journal;
+
+	//! Where to remember tests' durations.
+	const HistoryOptions history;
+
+	//! How to calibrate (or which calibrated timeouts to use).
+	const CalibrationOptions calibration;
 };
 
 //! Formats test result
@@ -95,6 +254,326 @@ protected:
 };
 
 
+/**
+ * A suite's tags, compiled into one bitset per test.
+ *
+ * Each distinct tag is given an integer ID (a bit position), so checking
+ * a test against a set of tags is a few word-wide ANDs rather than a
+ * string lookup per tag.
+ */
+class TagIndex
+{
+	public:
+	//! Assign IDs to every tag used in a suite.
+	TagIndex(const std::vector<Test>&);
+
+	//! The indices of the tests that a filter selects, in suite order.
+	std::vector<size_t> select(const std::vector<Test>&,
+	                           const TestFilter&) const;
+
+	private:
+	typedef uint64_t Word;
+
+	//! Compile a list of tags into a mask (ignoring unknown tags).
+	std::vector<Word> mask(const std::vector<std::string> &tags) const;
+
+	//! Does a test have any of the tags in a mask?
+	bool any(size_t test, const std::vector<Word> &mask) const;
+
+	std::unordered_map<std::string, size_t> ids_;
+	size_t words_;                 //!< words per test's bitset
+	std::vector<Word> bits_;       //!< all tests' bitsets, end to end
+};
+
+
+/**
+ * The prerequisites of a suite's tests, and which tests are ready to run.
+ *
+ * Tests are identified by their indices within the suite. Ready tests are
+ * handed out in a fixed order (see @ref order) so that test runs are
+ * repeatable: with no prerequisites, this is simply suite order.
+ */
+class TestGraph
+{
+	public:
+	//! Resolve each test's prerequisites (by name and tag) to indices.
+	TestGraph(const std::vector<Test>&);
+
+	//! The order to report tests in (and start them in, by default).
+	const std::vector<size_t>& order() const { return order_; }
+
+	//! The tests that have a given test as a prerequisite.
+	const std::vector<size_t>& dependents(size_t test) const
+	{
+		return dependents_[test];
+	}
+
+	/**
+	 * Start tests that lead to the most work first (rather than in
+	 * @ref order), as in longest-processing-time-first scheduling.
+	 *
+	 * A test leads to its own expected duration plus the longest chain
+	 * of work among its dependents, so that long chains of prerequisites
+	 * start early. This must be called before @ref next.
+	 */
+	void prioritize(const std::vector<std::chrono::microseconds>&);
+
+	//! Take the next ready test, or return @ref size() if none are ready.
+	size_t next();
+
+	/**
+	 * Record that a test has finished.
+	 *
+	 * @returns   tests that must now be skipped (because this test, or
+	 *            a test that depended on it, didn't pass), which are
+	 *            also considered finished
+	 */
+	std::vector<size_t> finished(size_t test, TestExitStatus);
+
+	/**
+	 * Tests that can never become ready: they depend on each other.
+	 *
+	 * This should only be called once nothing is running and @ref next
+	 * has nothing left to offer.
+	 */
+	std::vector<size_t> stuck() const;
+
+	//! The number of tests in the graph.
+	size_t size() const { return waiting_.size(); }
+
+	private:
+	std::vector<std::vector<size_t>> dependents_;
+	std::vector<size_t> waiting_;          //!< unfinished prerequisites
+	std::vector<bool> done_;
+	std::vector<size_t> order_;
+	std::vector<size_t> dispatch_;         //!< the order to start tests in
+	std::vector<size_t> rank_;             //!< index of a test in dispatch_
+	std::set<size_t> ready_;               //!< ranks of ready tests
+};
+
+
+/**
+ * Identify the code under test, for keying saved results.
+ *
+ * @param   submission  a name for the code under test (e.g., a student ID
+ *                      and commit), or empty to hash the test executable
+ * @param   executable  the test executable (in case /proc isn't mounted)
+ * @param   id          the identifier (a hash)
+ *
+ * @returns   false if the test executable couldn't be read
+ */
+bool IdentifySubmission(const std::string &submission,
+                        const std::string &executable, uint64_t &id);
+
+/**
+ * Identify a test within a submission, by a hash of the submission's
+ * identifier and the test's index, name and description.
+ */
+uint64_t IdentifyTest(uint64_t submission, const Test&);
+
+
+/**
+ * An on-disk cache of test results.
+ *
+ * Each result is stored in a file of its own (in the format written by
+ * @ref WriteShardResult), named by a hash of the code under test, the
+ * test's name and description and the limits it runs under.
+ */
+class ResultCache
+{
+	public:
+	/**
+	 * Constructor.
+	 *
+	 * @param   options     where to keep results and what to key them by
+	 * @param   strategy    how tests are run (e.g., sandboxed or not)
+	 * @param   executable  the test executable (if the submission isn't
+	 *                      identified by @a options)
+	 */
+	ResultCache(const CacheOptions &options, TestRunStrategy strategy,
+	            const std::string &executable);
+
+	//! Can results be cached (e.g., was the executable readable)?
+	bool usable() const { return usable_; }
+
+	//! Look up a test's result, returning nullptr on a cache miss.
+	std::unique_ptr<TestResult> find(const Test&, const ChildLimits&) const;
+
+	//! Save a test's result (if it's worth keeping).
+	void store(const Test&, const ChildLimits&, const TestResult&) const;
+
+	private:
+	//! The file that a test's result would be stored in.
+	std::string path(const Test&, const ChildLimits&) const;
+
+	const std::string directory_;
+	const TestRunStrategy strategy_;
+	uint64_t submission_;
+	bool usable_;
+};
+
+
+/**
+ * An append-only journal of a suite run's results.
+ *
+ * Results are written (in the format written by @ref WriteShardResult) as
+ * soon as each test finishes, so nothing is lost if the test suite is
+ * killed. To bound the cost of fsync(2), it is only called after every
+ * few results or every second, so a host crash may lose the last few.
+ *
+ * Each result is keyed by @ref IdentifyTest rather than by its index alone,
+ * so resuming with a rebuilt executable or a reordered suite reruns the
+ * tests that no longer match.
+ */
+class Journal
+{
+	public:
+	/**
+	 * Open a journal, truncating it unless we are resuming from it.
+	 *
+	 * When resuming, the results already in the journal are read back
+	 * and the journal is rewritten with only the results that match
+	 * @a tests (dropping any partially-written result at its end).
+	 *
+	 * @param   submission   identifies the code under test
+	 *                       (see @ref IdentifySubmission)
+	 */
+	Journal(const JournalOptions&, const std::vector<Test> &tests,
+	        uint64_t submission);
+
+	//! Sync any unsynced results to stable storage.
+	~Journal();
+
+	//! Could the journal be opened?
+	bool usable() const { return fd_ >= 0; }
+
+	//! Look up a test's result from an earlier run (or return nullptr).
+	std::unique_ptr<TestResult> find(const Test&) const;
+
+	//! Append a test's result to the journal.
+	void record(const Test&, const TestResult&);
+
+	private:
+	//! Sync the journal to stable storage.
+	void sync();
+
+	const uint64_t submission_;
+	std::map<size_t, TestResult> earlier_;    //!< keyed by test index
+	int fd_;
+	unsigned int unsynced_;
+	std::chrono::steady_clock::time_point lastSync_;
+};
+
+
+/**
+ * How long tests took in earlier runs, keyed by test name.
+ *
+ * The history is kept in a small text file: a header line followed by one
+ * `microseconds name` line per test. Tests that aren't run keep their old
+ * durations; tests that are run are averaged with their old durations, so
+ * that one slow run doesn't change the schedule too much.
+ */
+class TestHistory
+{
+	public:
+	//! Read a history file (which needn't exist yet).
+	TestHistory(const std::string &filename);
+
+	//! Save the updated history.
+	~TestHistory();
+
+	/**
+	 * Estimate how long each test will take.
+	 *
+	 * Tests that we haven't seen before are assumed to take as long as
+	 * the longest test that we have seen, so that they start early.
+	 */
+	std::vector<std::chrono::microseconds>
+	estimate(const std::vector<Test>&) const;
+
+	//! Remember how long a test took to run.
+	void record(const Test&, const TestResult&);
+
+	private:
+	const std::string filename_;
+	std::map<std::string, std::chrono::microseconds> durations_;
+	bool changed_;
+};
+
+
+/**
+ * Calibrates tests' timeouts from their durations over several runs.
+ *
+ * This formatter records the duration of every test that it sees, passing
+ * results on to another formatter (if any) to be reported.
+ */
+class TimeoutCalibration : public Formatter
+{
+	public:
+	TimeoutCalibration(std::ostream&);
+
+	//! Report results with another formatter (or not, if null).
+	void report(Formatter *f) { report_ = f; }
+
+	virtual void testBeginning(const Test&) override;
+	virtual void testEnded(const Test&, const TestResult&) override;
+
+	/**
+	 * Write a profile of timeouts that @ref ReadTimeoutProfile can read.
+	 *
+	 * Each test's timeout is a multiple of its 95th-percentile duration,
+	 * plus a floor to absorb scheduling noise on a loaded machine.
+	 */
+	bool save(const std::string &filename) const;
+
+	private:
+	Formatter *report_;
+	std::map<std::string, std::vector<std::chrono::microseconds>> samples_;
+};
+
+/**
+ * Read a timeout profile written by @ref TimeoutCalibration::save.
+ *
+ * @param   timeouts   where to put timeouts, keyed by test name
+ *
+ * @returns   whether the profile could be read
+ */
+bool ReadTimeoutProfile(const std::string &filename,
+                        std::map<std::string, Timeout> &timeouts);
+
+
+/**
+ * Choose one shard of a suite's tests.
+ *
+ * Tests are divided into @a shards sets of roughly equal cost, without
+ * separating tests from their prerequisites. Every shard makes the same
+ * (deterministic) choices, so together they run every test exactly once.
+ *
+ * @returns   the indices of the tests in shard @a shard, in order
+ */
+std::vector<size_t> ChooseShard(const std::vector<Test>&,
+                                unsigned int shard, unsigned int shards);
+
+//! Begin a file of results that @ref ReadShardResults can read.
+void WriteShardHeader(std::ostream&);
+
+/**
+ * Write a test's result in a form that @ref ReadShardResults can read.
+ *
+ * @param   index     the test's @ref Test::index
+ */
+void WriteShardResult(std::ostream&, size_t index, const TestResult&);
+
+/**
+ * Read results written by @ref WriteShardResult.
+ *
+ * @param   results    where to put results, keyed by @ref Test::index
+ *
+ * @returns   whether the results could be read
+ */
+bool ReadShardResults(std::istream&, std::map<size_t, TestResult> &results);
+
+
 /**
  * A representation of a shared memory object.
  *
@@ -112,6 +591,9 @@ class SharedMemory
 	 * after this object is destructed.
 	 */
 	virtual void* rawPointer() const = 0;
+
+	//! The size of the shared memory [B].
+	virtual size_t size() const = 0;
 };
 
 
@@ -119,23 +601,285 @@ class SharedMemory
 std::unique_ptr<SharedMemory> MapSharedData(size_t size);
 
 
+//! Robust statistics about a set of timed samples.
+struct SampleSummary
+{
+	double median;
+	double mad;                 //!< median absolute deviation
+	unsigned long outliers;     //!< samples rejected as outliers
+};
+
+/**
+ * Reject outlying samples (more than a few scaled MADs from the median),
+ * then find the median and MAD of the rest. If that would reject most of
+ * the samples (e.g., because most are identical), none are rejected.
+ */
+SampleSummary Summarize(const std::vector<double> &samples);
+
+/**
+ * Time code against a reference implementation (in the test's process).
+ *
+ * @param   samples    how many timed samples to take of each
+ */
+BenchmarkStatistics RunBenchmark(const TestClosure &code,
+                                 const TestClosure &reference,
+                                 unsigned int samples);
+
+/**
+ * Wrap a test's closure so that, after it checks correctness, it runs a
+ * benchmark (see @ref TestBuilder::benchmark).
+ *
+ * The closure records the benchmark's statistics in shared memory (if
+ * any) and fails the test if the code is too slow.
+ */
+TestClosure BenchmarkClosure(TestClosure check, TestClosure code,
+                             TestClosure reference, double maxRatio,
+                             unsigned int samples,
+                             std::shared_ptr<SharedMemory> statistics);
+
+/**
+ * Measure code at each of several input sizes (each in a child of the
+ * test's process), record the measurements in shared memory and fit
+ * complexity classes to them.
+ */
+ComplexityStatistics RunComplexity(const SizedClosure &code,
+                                   const std::vector<size_t> &sizes,
+                                   Complexity expected,
+                                   ComplexityMetric metric,
+                                   const SharedMemory &record);
+
+//! Fit complexity classes to a complexity test's costs.
+void FitComplexity(ComplexityStatistics&);
+
+/**
+ * Wrap a test's closure so that, after it checks correctness, it measures
+ * the growth of some code's cost (see @ref TestBuilder::complexity).
+ *
+ * The closure records its measurements in shared memory (which its
+ * per-size processes write to) and fails the test if their complexity is
+ * worse than expected.
+ */
+TestClosure ComplexityClosure(TestClosure check, SizedClosure code,
+                              std::vector<size_t> sizes, Complexity expected,
+                              ComplexityMetric metric,
+                              std::shared_ptr<SharedMemory> record);
+
+//! The shared memory needed to record a complexity test's measurements.
+size_t ComplexityRecordSize(size_t sizes);
+
+//! Read (and fit) the measurements that a complexity test recorded.
+ComplexityStatistics ReadComplexityRecord(const SharedMemory&);
+
+
+/**
+ * Counters for a test's allocations, which the global `operator new` and
+ * `operator delete` update while the test runs (see @ref AllocationClosure).
+ *
+ * The counters live in memory that is shared with the test suite, so that
+ * they can be read even if the test crashes.
+ */
+struct AllocationCounters
+{
+	std::atomic<bool> tracked;
+	std::atomic<unsigned long> allocations;
+	std::atomic<unsigned long> deallocations;
+	std::atomic<size_t> bytes;
+
+	//! Blocks allocated minus blocks deleted (which may be negative
+	//! if the test deletes memory that was allocated before it ran).
+	std::atomic<long long> liveBlocks;
+	std::atomic<long long> liveBytes;       //!< as for liveBlocks [B]
+	std::atomic<long long> peakBytes;       //!< the most live bytes [B]
+};
+
+/**
+ * The counters of the test that is tracking its allocations (if any), which
+ * the grading-allocations library's `operator new` and `operator delete`
+ * update. Programs that don't link that library never count anything.
+ */
+extern std::atomic<AllocationCounters*> trackedAllocations;
+
+//! Read the statistics that a test's @ref AllocationCounters recorded.
+AllocationStatistics ReadAllocationCounters(const SharedMemory&);
+
+/**
+ * Wrap a test's closure so that its allocations are counted (see
+ * @ref TestBuilder::trackAllocations) in shared memory.
+ *
+ * The closure fails the test if it makes more than @a maxAllocations
+ * allocations, has more than @a maxBytes live at once (where zero means
+ * "no limit") or, if @a forbidLeaks is set, leaks any memory. If there are
+ * no @a counters, or the program doesn't link grading-allocations, the test
+ * exits with @ref TestExitStatus::OtherError instead of running.
+ */
+TestClosure AllocationClosure(TestClosure test, unsigned long maxAllocations,
+                              size_t maxBytes, bool forbidLeaks,
+                              std::shared_ptr<SharedMemory> counters);
+
+
+/**
+ * Prepare to run sandboxed tests, if supported.
+ *
+ * This is called once per test suite, before any tests are started. It does
+ * work that test processes can inherit rather than each repeating (e.g.,
+ * building a seccomp filter) and checks what they'll be able to use (e.g.,
+ * Linux namespaces), without confining the test suite itself.
+ */
+void PrepareSandbox();
+
+/**
+ * Move this process into the sandbox's namespaces, if supported (and not
+ * already done), so that any test processes that it forks share them.
+ *
+ * Test processes do this for themselves in @ref EnterSandbox; servers call
+ * it to do it once for all of the tests that they fork.
+ */
+void EnterSandboxNamespaces();
+
+/**
+ * Prepare to give tests scratch directories.
+ *
+ * This creates the directory that holds tests' scratch directories, which
+ * is deleted (along with anything left in it) when the test suite exits.
+ */
+void PrepareScratchDirectories();
+
 /**
  * Enter unprivileged testing sandbox, if supported.
+ *
+ * This may be called more than once in a process (e.g., a batch server).
  */
 void EnterSandbox();
 
+/**
+ * Measures the resources used by this process while it runs a test
+ * in-process (e.g., inline or within a batch server).
+ */
+class UsageMeter
+{
+	public:
+	//! Constructor: start measuring.
+	UsageMeter();
+
+	//! The resources used since construction.
+	ResourceUsage elapsed() const;
+
+	private:
+	const std::chrono::steady_clock::time_point start_;
+	const ResourceUsage before_;
+};
+
+/**
+ * A test that is running in another process.
+ *
+ * This class is specialized by platform-specific code to represent
+ * a child process that is running a test closure.
+ */
+class ChildTest
+{
+	public:
+	virtual ~ChildTest() {}
+
+	/**
+	 * Check whether the test has finished without blocking.
+	 *
+	 * If the test has exceeded its timeout or output limit, it will
+	 * be killed and reported as finished.
+	 */
+	virtual bool done() = 0;
+
+	//! Wait for the test to finish and retrieve its result.
+	virtual TestResult result() = 0;
+};
+
+/**
+ * Start running a test in another process.
+ *
+ * @returns   the running test, or nullptr if the test could not be started
+ */
+std::unique_ptr<ChildTest> StartTest(TestClosure test, const ChildLimits&);
+
+/**
+ * Block until at least one of the given tests has finished.
+ */
+void WaitForAny(const std::vector<ChildTest*>&);
+
 /**
  * Run a test in another process.
  */
-TestResult ForkTest(TestClosure test, time_t timeout);
+TestResult ForkTest(TestClosure test, const ChildLimits&);
+
+/**
+ * A process, forked from the test suite, that runs tests on request.
+ */
+class TestServer
+{
+	public:
+	virtual ~TestServer() {}
+
+	//! Is the server currently running a test?
+	virtual bool busy() const = 0;
+
+	/**
+	 * Start running a test in the server.
+	 *
+	 * @param   index    the test's index in the list of tests given to
+	 *                   @ref StartForkServer or @ref StartBatchServer
+	 * @param   limits   limits on the test (e.g., timeout)
+	 *
+	 * @returns   the running test, or nullptr if it could not be started
+	 */
+	virtual std::unique_ptr<ChildTest> start(size_t index,
+	                                         const ChildLimits &limits) = 0;
+};
+
+/**
+ * Start a fork server that can run any of the given tests.
+ *
+ * The server forks a fresh child for each test it is asked to run.
+ *
+ * @returns   the server, or nullptr if it could not be started
+ */
+std::unique_ptr<TestServer> StartForkServer(std::vector<TestClosure>);
+
+/**
+ * Start a batch server that can run any of the given tests.
+ *
+ * The server runs one test after another within its own process.
+ * If a test fails, crashes or times out, the server process is
+ * discarded and a new one is forked to run the next test.
+ *
+ * @returns   the server, or nullptr if it could not be started
+ */
+std::unique_ptr<TestServer> StartBatchServer(std::vector<TestClosure>);
 
 /**
  * Run a test in the current process, catching all exceptions.
  *
  * This function returns a TestExitStatus, not a TestResult. Redirecting
  * stdout and stderr, if desired, is the responsibility of the caller.
+ *
+ * A std::bad_alloc is reported as @ref TestExitStatus::MemoryLimit only if
+ * the test is running under a memory limit.
+ */
+TestExitStatus RunInProcess(TestClosure test, const ChildLimits&);
+
+/**
+ * Run a closure in a child process (forked from this one) and wait for it,
+ * e.g., to measure code without the effects of earlier measurements.
+ *
+ * @returns whether the closure returned (rather than exiting, crashing or
+ *          throwing an exception)
+ */
+bool RunIsolated(const TestClosure&);
+
+/**
+ * Count the instructions that this process (and any children it creates)
+ * retires in user mode while running a closure.
+ *
+ * @returns the count, or -1 if instructions can't be counted here
  */
-TestExitStatus RunInProcess(TestClosure test);
+long long CountInstructions(const TestClosure&);
 
 } // namespace grading
 
@@ -0,0 +1,330 @@
+/*!
+ * @file      profile.cpp
+ * @brief     @internal POSIX implementation of @ref grading::StackProfile.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "posix.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/time.h>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <execinfo.h>
+#include <signal.h>
+
+using namespace grading;
+using std::string;
+using std::vector;
+
+
+namespace {
+
+/**
+ * How often to sample the test's stack (in CPU time) [us].
+ * The kernel may round this up to its clock tick.
+ */
+const long SampleInterval = 1000;
+
+//! The most frames to record from each sample.
+const int MaxDepth = 64;
+
+/**
+ * Frames at the top of a sample's stack that belong to the sampler:
+ * @ref Sample itself and the kernel's signal trampoline.
+ */
+const int SamplerFrames = 2;
+
+//! Distinct code addresses that the histogram can hold.
+const size_t Slots = 4096;
+
+//! Functions to report.
+const size_t TopFunctions = 10;
+
+
+//! A code address and how often it has been sampled.
+struct Slot
+{
+	std::atomic<uintptr_t> pc;
+	std::atomic<unsigned long> self;    //!< samples at this address
+	std::atomic<unsigned long> total;   //!< samples with it on the stack
+};
+
+//! A hash table of sampled code addresses (in shared memory).
+struct Histogram
+{
+	std::atomic<unsigned long> samples;
+	std::atomic<unsigned long> dropped; //!< addresses that didn't fit
+	Slot slots[Slots];
+};
+
+//! The histogram that this (test) process is sampling into.
+Histogram *sampling = nullptr;
+
+
+//! Find (or claim) a code address' slot, without taking any locks.
+Slot* Find(Histogram &h, uintptr_t pc)
+{
+	size_t i = (pc ^ (pc >> 12)) % Slots;
+
+	for (size_t probe = 0; probe < Slots; probe++)
+	{
+		Slot &slot = h.slots[i];
+
+		uintptr_t current = slot.pc.load();
+		if (current == 0 and slot.pc.compare_exchange_strong(current, pc))
+			return &slot;
+
+		if (current == pc)
+			return &slot;
+
+		i = (i + 1) % Slots;
+	}
+
+	return nullptr;
+}
+
+
+//! The SIGPROF handler: record the interrupted stack.
+void Sample(int, siginfo_t*, void*)
+{
+	Histogram *h = sampling;
+	if (not h)
+		return;
+
+	const int savedErrno = errno;
+
+	void *frames[MaxDepth];
+	const int depth = backtrace(frames, MaxDepth);
+
+	h->samples++;
+
+	for (int i = SamplerFrames; i < depth; i++)
+	{
+		// Return addresses point after their calls: look up the call.
+		uintptr_t pc = reinterpret_cast<uintptr_t>(frames[i]);
+		if (i > SamplerFrames)
+			pc--;
+
+		// Count recursive frames only once towards the total.
+		bool repeated = false;
+		for (int j = SamplerFrames; j < i and not repeated; j++)
+		{
+			repeated = (frames[j] == frames[i]);
+		}
+
+		if (repeated)
+			continue;
+
+		Slot *slot = Find(*h, pc);
+		if (not slot)
+		{
+			h->dropped++;
+			continue;
+		}
+
+		slot->total++;
+		if (i == SamplerFrames)
+			slot->self++;
+	}
+
+	errno = savedErrno;
+}
+
+
+//! Name the function that contains a code address (as well as we can).
+string Symbolize(uintptr_t pc)
+{
+	std::ostringstream name;
+
+	Dl_info info;
+	if (dladdr(reinterpret_cast<void*>(pc), &info) == 0)
+	{
+		name << "0x" << std::hex << pc;
+		return name.str();
+	}
+
+	if (info.dli_sname)
+	{
+		int status;
+		char *demangled =
+			abi::__cxa_demangle(info.dli_sname, nullptr, nullptr,
+			                    &status);
+
+		name << ((status == 0) ? demangled : info.dli_sname);
+		free(demangled);
+
+		return name.str();
+	}
+
+	// Without a symbol, give an offset that addr2line(1) can look up.
+	const char *file = info.dli_fname ? info.dli_fname : "";
+	const char *slash = strrchr(file, '/');
+
+	name
+		<< (slash ? slash + 1 : file) << "+0x" << std::hex
+		<< (pc - reinterpret_cast<uintptr_t>(info.dli_fbase))
+		;
+
+	return name.str();
+}
+
+} // anonymous namespace
+
+
+StackProfile::StackProfile()
+	: samples_(MapSharedData(sizeof(Histogram)))
+{
+}
+
+
+void StackProfile::start() const
+{
+	if (not samples_)
+		return;
+
+	sampling = static_cast<Histogram*>(samples_->rawPointer());
+
+	// backtrace(3) may load the unwinder the first time that it's called,
+	// which wouldn't be safe in a signal handler.
+	void *frame;
+	backtrace(&frame, 1);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = Sample;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+
+	struct itimerval timer;
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_usec = SampleInterval;
+	timer.it_value = timer.it_interval;
+
+	if (sigaction(SIGPROF, &action, nullptr) != 0
+	    or setitimer(ITIMER_PROF, &timer, nullptr) != 0)
+	{
+		sampling = nullptr;
+	}
+}
+
+
+string StackProfile::report() const
+{
+	if (not samples_)
+		return "";
+
+	const Histogram &h = *static_cast<Histogram*>(samples_->rawPointer());
+	const unsigned long samples = h.samples;
+
+	std::ostringstream report;
+	report << "Profile of the test's stack";
+
+	if (samples == 0)
+	{
+		report
+			<< ": no samples (the test used no CPU time;"
+			<< " was it waiting for something?)\n"
+			;
+
+		return report.str();
+	}
+
+	report << " (" << samples << " samples of CPU time):\n";
+
+	// Combine the addresses within each function.
+	struct Function
+	{
+		string name;
+		unsigned long self;
+		unsigned long total;
+	};
+
+	std::map<string, Function> functions;
+	for (const Slot &slot : h.slots)
+	{
+		const uintptr_t pc = slot.pc;
+		if (pc == 0)
+			continue;
+
+		const string name = Symbolize(pc);
+		Function &f = functions[name];
+		f.name = name;
+		f.self += slot.self;
+		f.total += slot.total;
+	}
+
+	vector<Function> hottest;
+	for (auto &i : functions)
+	{
+		if (i.second.self > 0)
+			hottest.push_back(i.second);
+	}
+
+	std::sort(hottest.begin(), hottest.end(),
+		[](const Function &x, const Function &y)
+		{
+			return (x.self != y.self)
+				? (x.self > y.self)
+				: (x.total > y.total);
+		});
+
+	if (hottest.size() > TopFunctions)
+		hottest.resize(TopFunctions);
+
+	auto percent = [samples](unsigned long n)
+	{
+		std::ostringstream oss;
+		oss
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(6) << (100.0 * std::min(n, samples) / samples)
+			<< "%"
+			;
+
+		return oss.str();
+	};
+
+	report << "   self   total  function\n";
+	for (const Function &f : hottest)
+	{
+		report
+			<< percent(f.self) << " " << percent(f.total)
+			<< "  " << f.name << "\n"
+			;
+	}
+
+	if (h.dropped > 0)
+	{
+		report
+			<< "(" << h.dropped << " frames were not recorded:"
+			<< " the histogram was full)\n"
+			;
+	}
+
+	return report.str();
+}
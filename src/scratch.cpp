@@ -0,0 +1,272 @@
+/*!
+ * @file      scratch.cpp
+ * @brief     @internal POSIX implementation of per-test scratch directories.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "posix.h"
+
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <errno.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <unistd.h>
+
+using namespace grading;
+using std::string;
+
+
+namespace {
+
+//! nftw(3) callback that removes everything it visits.
+int RemoveEntry(const char *path, const struct stat*, int, struct FTW*)
+{
+	remove(path);
+	return 0;
+}
+
+//! Recursively remove a directory (without following symlinks).
+void RemoveTree(const string &path)
+{
+	nftw(path.c_str(), RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+
+/**
+ * @brief The directory that holds a test suite's scratch directories.
+ *
+ * Where tests can mount private filesystems (see @ref MountPrivateTmpfs),
+ * every test mounts its own tmpfs over the same `work` directory, which
+ * disappears along with the test's mount namespace. Otherwise, each test
+ * gets a directory of its own, which a background thread deletes after the
+ * test finishes.
+ *
+ * Only the process that created the root (i.e., the test suite) cleans it
+ * up: forked test processes and servers share the object but not the thread.
+ * The object is never destroyed, since destroying a condition variable that
+ * a (non-existent) thread was waiting on would hang a forked process.
+ */
+class ScratchRoot
+{
+	public:
+	ScratchRoot() : owner_(0), janitor_(nullptr), stopping_(false) {}
+
+	//! Stop the janitor and delete everything (in the owner only).
+	void finish();
+
+	//! Create the root directory (if it doesn't already exist).
+	bool prepare();
+
+	//! Create a scratch directory for a test.
+	string create(bool privateMount);
+
+	//! The directory that tests mount private filesystems over.
+	string mountPoint() const { return path_ + "/work"; }
+
+	//! Queue a test's scratch directory for deletion.
+	void discard(const string&);
+
+	private:
+	//! The background thread: delete discarded directories.
+	void clean();
+
+	pid_t owner_;
+	string path_;
+
+	std::thread *janitor_;
+	std::mutex mutex_;
+	std::condition_variable wakeup_;
+	std::deque<string> discarded_;
+	bool stopping_;
+};
+
+//! Get the (lazily-created and never-destroyed) scratch root.
+ScratchRoot& Root()
+{
+	static ScratchRoot *root = nullptr;
+	if (not root)
+	{
+		root = new ScratchRoot;
+		atexit([]() { Root().finish(); });
+	}
+
+	return *root;
+}
+
+
+//! Where to put scratch directories: prefer memory-backed /dev/shm.
+string ScratchParent()
+{
+	const char *tmpdir = getenv("TMPDIR");
+	if (tmpdir != nullptr and *tmpdir != '\0')
+		return tmpdir;
+
+	if (access("/dev/shm", W_OK | X_OK) == 0)
+		return "/dev/shm";
+
+	return "/tmp";
+}
+
+
+void ScratchRoot::finish()
+{
+	if (owner_ == 0 or owner_ != getpid())
+		return;
+
+	if (janitor_)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+
+		wakeup_.notify_one();
+		janitor_->join();
+		delete janitor_;
+	}
+
+	RemoveTree(path_);
+}
+
+
+bool ScratchRoot::prepare()
+{
+	if (owner_ != 0)
+		return true;
+
+	string pattern = ScratchParent() + "/libgrading.XXXXXX";
+	std::vector<char> buffer(pattern.begin(), pattern.end());
+	buffer.push_back('\0');
+
+	if (mkdtemp(buffer.data()) == nullptr)
+		return false;
+
+	path_ = buffer.data();
+	owner_ = getpid();
+
+	return true;
+}
+
+
+string ScratchRoot::create(bool privateMount)
+{
+	if (not prepare())
+		return "";
+
+	if (privateMount and PrivateMountsAvailable())
+	{
+		if (mkdir(mountPoint().c_str(), 0700) != 0 and errno != EEXIST)
+			return "";
+
+		return mountPoint();
+	}
+
+	string pattern = path_ + "/test.XXXXXX";
+	std::vector<char> buffer(pattern.begin(), pattern.end());
+	buffer.push_back('\0');
+
+	if (mkdtemp(buffer.data()) == nullptr)
+		return "";
+
+	return buffer.data();
+}
+
+
+void ScratchRoot::discard(const string &dir)
+{
+	// Private mounts clean up after themselves.
+	if (dir == mountPoint())
+		return;
+
+	// Only the suite's own process runs a janitor. Elsewhere (e.g., in a
+	// batch server), leave the directory for the suite to delete at exit.
+	if (owner_ != getpid())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		discarded_.push_back(dir);
+	}
+
+	if (not janitor_)
+	{
+		janitor_ = new std::thread(&ScratchRoot::clean, this);
+	}
+
+	wakeup_.notify_one();
+}
+
+
+void ScratchRoot::clean()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	while (true)
+	{
+		wakeup_.wait(lock, [this]()
+		{
+			return stopping_ or not discarded_.empty();
+		});
+
+		if (discarded_.empty())
+			return;
+
+		const string dir = discarded_.front();
+		discarded_.pop_front();
+
+		lock.unlock();
+		RemoveTree(dir);
+		lock.lock();
+	}
+}
+
+} // anonymous namespace
+
+
+void grading::PrepareScratchDirectories()
+{
+	Root().prepare();
+}
+
+
+string grading::CreateScratchDirectory(bool privateMount)
+{
+	return Root().create(privateMount);
+}
+
+
+bool grading::EnterScratchDirectory(const string &dir)
+{
+	if (dir == Root().mountPoint() and not MountPrivateTmpfs(dir))
+		return false;
+
+	return chdir(dir.c_str()) == 0;
+}
+
+
+void grading::DiscardScratchDirectory(const string &dir)
+{
+	Root().discard(dir);
+}
@@ -0,0 +1,318 @@
+/*!
+ * @file      shard.cpp
+ * @brief     Dividing test suites into shards and merging their results.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "private.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+
+using namespace grading;
+using std::istream;
+using std::map;
+using std::ostream;
+using std::string;
+using std::vector;
+
+
+//! The first line of a results file: a name and a format version.
+static const char ResultsHeader[] = "libgrading-results 8";
+
+
+//! Find the representative of a test's group (with path halving).
+static size_t Find(vector<size_t> &group, size_t i)
+{
+	while (group[i] != i)
+	{
+		group[i] = group[group[i]];
+		i = group[i];
+	}
+
+	return i;
+}
+
+
+vector<size_t> grading::ChooseShard(const vector<Test> &tests,
+                                    unsigned int shard, unsigned int shards)
+{
+	const size_t count = tests.size();
+
+	// Tests that are connected by prerequisites must share a shard.
+	const TestGraph graph(tests);
+	vector<size_t> group(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		group[i] = i;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		for (size_t d : graph.dependents(i))
+		{
+			group[Find(group, d)] = Find(group, i);
+		}
+	}
+
+	// Every test costs at least something, even if it's worth nothing.
+	vector<unsigned long> cost(count, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		cost[Find(group, i)] += std::max(tests[i].weight(), 1u);
+	}
+
+	// Assign the most expensive groups first, each to the shard with the
+	// least work so far (the "longest processing time" rule). Ties are
+	// broken by index, so that every shard makes the same choices.
+	vector<size_t> groups;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (Find(group, i) == i)
+			groups.push_back(i);
+	}
+
+	std::stable_sort(groups.begin(), groups.end(),
+		[&cost](size_t x, size_t y) { return cost[x] > cost[y]; });
+
+	vector<unsigned long> load(shards, 0);
+	vector<unsigned int> assigned(count, 0);
+	for (size_t g : groups)
+	{
+		const auto lightest = std::min_element(load.begin(), load.end());
+		*lightest += cost[g];
+		assigned[g] = static_cast<unsigned int>(lightest - load.begin());
+	}
+
+	vector<size_t> chosen;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (assigned[Find(group, i)] == shard)
+			chosen.push_back(i);
+	}
+
+	return chosen;
+}
+
+
+void grading::WriteShardHeader(ostream &out)
+{
+	out << ResultsHeader << "\n";
+}
+
+
+void grading::WriteShardResult(ostream &out, size_t index,
+                               const TestResult &result)
+{
+	const ResourceUsage &u = result.usage;
+	const EventCounts &e = u.events;
+	const BenchmarkStatistics &b = result.benchmark;
+	const AllocationStatistics &a = result.allocations;
+	const ComplexityStatistics &c = result.complexity;
+	const OutputView output = result.outputView();
+	const OutputView errors = result.errorOutputView();
+
+	// Don't change the precision of the caller's stream.
+	std::ostringstream ratio;
+	ratio
+		<< std::setprecision(std::numeric_limits<double>::digits10)
+		<< b.ratio;
+
+	out
+		<< index
+		<< " " << static_cast<int>(result.status)
+		<< " " << u.wallTime.count()
+		<< " " << u.userTime.count()
+		<< " " << u.systemTime.count()
+		<< " " << u.maxResidentKiB
+		<< " " << u.minorFaults
+		<< " " << u.majorFaults
+		<< " " << u.voluntarySwitches
+		<< " " << u.involuntarySwitches
+		<< " " << u.strayProcesses
+		<< " " << b.samples
+		<< " " << b.iterations
+		<< " " << b.outliers
+		<< " " << b.median.count()
+		<< " " << b.mad.count()
+		<< " " << b.referenceMedian.count()
+		<< " " << ratio.str()
+		<< " " << e.instructions
+		<< " " << e.cycles
+		<< " " << e.cacheMisses
+		<< " " << e.branchMisses
+		<< " " << e.taskClock
+		<< " " << e.pageFaults
+		<< " " << e.multiplexed
+		<< " " << a.tracked
+		<< " " << a.allocations
+		<< " " << a.deallocations
+		<< " " << a.bytes
+		<< " " << a.peakBytes
+		<< " " << a.leakedBlocks
+		<< " " << a.leakedBytes
+		<< " " << static_cast<int>(c.expected)
+		<< " " << static_cast<int>(c.metric)
+		<< " " << c.sizes.size()
+		;
+
+	for (size_t i = 0; i < c.sizes.size(); i++)
+	{
+		out
+			<< " " << c.sizes[i] << " " << c.times[i].count()
+			<< " " << (i < c.instructions.size() ? c.instructions[i] : -1)
+			;
+	}
+
+	out
+		<< " " << output.size()
+		<< " " << errors.size()
+		<< "\n" << output << errors << "\n"
+		;
+
+	out.flush();
+}
+
+
+//! How many bytes are left to read from a stream (if it can tell us).
+static size_t Remaining(istream &in)
+{
+	const std::streampos here = in.tellg();
+	if (here < 0)
+		return std::numeric_limits<size_t>::max();
+
+	in.seekg(0, std::ios::end);
+	const std::streampos end = in.tellg();
+	in.seekg(here);
+
+	if (end < here)
+		return 0;
+
+	return static_cast<size_t>(end - here);
+}
+
+
+//! Read a result's output (of a known size).
+static bool ReadOutput(istream &in, size_t size, string &s)
+{
+	s.resize(size);
+	return size == 0 or in.read(&s[0], static_cast<std::streamsize>(size));
+}
+
+
+bool grading::ReadShardResults(istream &in, map<size_t, TestResult> &results)
+{
+	string header;
+	if (not std::getline(in, header) or header != ResultsHeader)
+		return false;
+
+	size_t index;
+	while (in >> index)
+	{
+		int status;
+		long wall, user, system;
+		ResourceUsage u;
+		long long median, mad, referenceMedian;
+		BenchmarkStatistics b;
+		AllocationStatistics a;
+		ComplexityStatistics c;
+		int expected, metric;
+		size_t points;
+		size_t outputSize, errorSize;
+
+		in
+			>> status >> wall >> user >> system
+			>> u.maxResidentKiB >> u.minorFaults >> u.majorFaults
+			>> u.voluntarySwitches >> u.involuntarySwitches
+			>> u.strayProcesses
+			>> b.samples >> b.iterations >> b.outliers
+			>> median >> mad >> referenceMedian >> b.ratio
+			>> u.events.instructions >> u.events.cycles
+			>> u.events.cacheMisses >> u.events.branchMisses
+			>> u.events.taskClock >> u.events.pageFaults
+			>> u.events.multiplexed
+			>> a.tracked >> a.allocations >> a.deallocations
+			>> a.bytes >> a.peakBytes >> a.leakedBlocks >> a.leakedBytes
+			>> expected >> metric >> points
+			;
+
+		// Each point takes at least six bytes ("1 2 3 ").
+		if (expected < 0 or expected > static_cast<int>(Complexity::Cubic)
+		    or metric < 0
+		    or metric > static_cast<int>(ComplexityMetric::Instructions)
+		    or points > Remaining(in) / 6)
+		{
+			return false;
+		}
+
+		c.metric = static_cast<ComplexityMetric>(metric);
+
+		for (size_t i = 0; in and i < points; i++)
+		{
+			size_t size;
+			long long time, instructions;
+			in >> size >> time >> instructions;
+
+			c.sizes.push_back(size);
+			c.times.emplace_back(time);
+
+			if (c.metric == ComplexityMetric::Instructions)
+				c.instructions.push_back(instructions);
+		}
+
+		in >> outputSize >> errorSize;
+
+		// Don't trust a (truncated or hostile) file's lengths or statuses.
+		if (not in or in.get() != '\n'
+		    or status < 0
+		    or status > static_cast<int>(TestExitStatus::Skipped)
+		    or outputSize > Remaining(in)
+		    or errorSize > Remaining(in) - outputSize)
+		{
+			return false;
+		}
+
+		string output, errors;
+		if (not ReadOutput(in, outputSize, output)
+		    or not ReadOutput(in, errorSize, errors))
+		{
+			return false;
+		}
+
+		u.wallTime = std::chrono::microseconds(wall);
+		u.userTime = std::chrono::microseconds(user);
+		u.systemTime = std::chrono::microseconds(system);
+
+		b.median = std::chrono::nanoseconds(median);
+		b.mad = std::chrono::nanoseconds(mad);
+		b.referenceMedian = std::chrono::nanoseconds(referenceMedian);
+
+		c.expected = static_cast<Complexity>(expected);
+		FitComplexity(c);
+
+		results.erase(index);
+		results.emplace(index, TestResult(
+			static_cast<TestExitStatus>(status),
+			std::move(output), std::move(errors), u, b, a, c));
+	}
+
+	return in.eof();
+}
@@ -0,0 +1,770 @@
+/*!
+ * @file      testserver.cpp
+ * @brief     @internal POSIX implementation of @ref grading::TestServer
+ *            (fork servers and batch servers).
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include "private.h"
+#include "posix.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0      // use SO_NOSIGPIPE instead (e.g., macOS)
+#endif
+
+#ifndef SOCK_CLOEXEC
+#define SOCK_CLOEXEC 0      // use FD_CLOEXEC instead (e.g., macOS)
+#endif
+
+using namespace grading;
+using namespace std;
+
+
+namespace {
+
+//! A request from the test suite to a test server: run one test.
+struct Request
+{
+	uint32_t index;         //!< index of the test to run
+	ChildLimits limits;     //!< limits on the test (e.g., timeout)
+};
+
+//! The beginning of a reply from a test server: the test's result.
+struct Reply
+{
+	int32_t status;         //!< a @ref TestExitStatus
+	uint32_t outputLength;  //!< bytes of stdout that follow this header
+	uint32_t errorLength;   //!< bytes of stderr that follow stdout
+	ResourceUsage usage;    //!< resources used by the test
+};
+
+
+/**
+ * @brief A test server running in a child of the test suite's process.
+ *
+ * A fork server forks a child for every test and enforces its limits,
+ * replying with the test's result and output. A batch server runs tests
+ * in its own process, replying with each test's status; its stdout and
+ * stderr are pipes that the test suite drains directly. The test suite
+ * enforces batched tests' limits and collects the exit status of a
+ * batch server that dies during a test.
+ */
+class PosixTestServer : public TestServer
+{
+	public:
+	PosixTestServer(vector<TestClosure> tests, bool forkPerTest);
+	~PosixTestServer();
+
+	//! Fork the server process.
+	bool spawn();
+
+	virtual bool busy() const override { return busy_; }
+	virtual unique_ptr<ChildTest> start(size_t,
+	                                    const ChildLimits&) override;
+
+	//! Does the server fork a child for each test (vs running a batch)?
+	bool forkPerTest() const { return forkPerTest_; }
+
+	//! The socket that the server's replies arrive on.
+	int socket() const { return sock_; }
+
+	//! Descriptors to poll for the current test's output (batch server).
+	vector<int> outputfds() const;
+
+	//! Drain the current test's output (batch server).
+	void drainOutput(size_t maximum = 0);
+
+	//! The total amount of output from the current test (batch server).
+	size_t outputSize() const;
+
+	//! Receive a test result from the server (blocking).
+	TestResult receive();
+
+	//! Kill the server, reporting the current test's result as given.
+	TestResult kill(TestExitStatus);
+
+	private:
+	//! Disconnect from the server and wait for it to exit.
+	void stop();
+
+	//! Output captured from the current test (batch server).
+	TestResult capturedResult(TestExitStatus, ResourceUsage);
+
+	/**
+	 * Resources used by a batch server that has exited during a test.
+	 *
+	 * CPU time and other accounting cover the server's whole lifetime;
+	 * wall-clock time covers only the current test.
+	 */
+	ResourceUsage exitedUsage() const;
+
+	//! The server's main loop: run tests until the suite hangs up.
+	[[noreturn]] void serve(int sock);
+
+	//! Run a test within a fork server.
+	TestResult forkTest(const TestClosure&, const ChildLimits&);
+
+	//! Run a test within a batch server.
+	TestResult runTest(const TestClosure&, const ChildLimits&);
+
+	const vector<TestClosure> tests_;
+	const bool forkPerTest_;
+
+	//! A batch server's stdout and stderr (read by the test suite).
+	unique_ptr<OutputCapture> out_;
+	unique_ptr<OutputCapture> err_;
+
+	pid_t server_;
+	int sock_;
+	bool busy_;
+	int status_;              //!< wait(2) status of the server, once exited
+	struct rusage rusage_;    //!< wait4(2) accounting, once exited
+	long strays_;             //!< processes left behind by the server
+	std::chrono::steady_clock::time_point started_;   //!< current test
+};
+
+
+/**
+ * @brief A test running in (or in a child of) a @ref PosixTestServer.
+ */
+class ServerTest : public PollableTest
+{
+	//! Monotonic clock used to enforce timeouts.
+	typedef std::chrono::steady_clock Clock;
+
+	public:
+	ServerTest(PosixTestServer &server, const ChildLimits &limits)
+		: server_(server), limits_(limits),
+		  deadline_(Clock::now() + limits.timeout)
+	{
+	}
+
+	virtual bool done() override;
+	virtual TestResult result() override;
+
+	virtual vector<int> pollfds() const override;
+	virtual int msUntilDeadline() const override;
+
+	private:
+	//! Does the test suite (rather than the server) enforce limits?
+	bool enforcingLimits() const { return not server_.forkPerTest(); }
+
+	PosixTestServer &server_;
+	const ChildLimits limits_;
+	const Clock::time_point deadline_;
+	unique_ptr<TestResult> result_;
+};
+
+
+//! Read exactly len bytes (or fail at EOF or error).
+bool ReadFully(int fd, void *buffer, size_t len)
+{
+	char *p = static_cast<char*>(buffer);
+
+	while (len > 0)
+	{
+		ssize_t n = read(fd, p, len);
+		if (n < 0 and errno == EINTR)
+			continue;
+
+		if (n <= 0)
+			return false;
+
+		p += n;
+		len -= static_cast<size_t>(n);
+	}
+
+	return true;
+}
+
+//! Send exactly len bytes over a socket (without raising SIGPIPE).
+bool SendFully(int sock, const void *buffer, size_t len)
+{
+	const char *p = static_cast<const char*>(buffer);
+
+	while (len > 0)
+	{
+		ssize_t n = send(sock, p, len, MSG_NOSIGNAL);
+		if (n < 0 and errno == EINTR)
+			continue;
+
+		if (n <= 0)
+			return false;
+
+		p += n;
+		len -= static_cast<size_t>(n);
+	}
+
+	return true;
+}
+
+} // anonymous namespace
+
+
+PosixTestServer::PosixTestServer(vector<TestClosure> tests, bool forkPerTest)
+	: tests_(std::move(tests)), forkPerTest_(forkPerTest),
+	  server_(-1), sock_(-1), busy_(false), status_(0), rusage_(),
+	  strays_(0)
+{
+}
+
+
+PosixTestServer::~PosixTestServer()
+{
+	if (busy_ and server_ > 0)
+		::kill(server_, SIGKILL);
+
+	stop();
+}
+
+
+bool PosixTestServer::spawn()
+{
+	// A batch server's output is read directly by the test suite.
+	if (not forkPerTest_)
+	{
+		const ChildLimits defaults;
+
+		out_.reset(new OutputCapture(defaults.outputHead,
+		                             defaults.outputTail));
+
+		err_.reset(new OutputCapture(defaults.outputHead,
+		                             defaults.outputTail));
+
+		if (not out_->open() or not err_->open())
+		{
+			return false;
+		}
+	}
+
+	// Tests that exec(2) other programs shouldn't pass the socket on.
+	int fds[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+	{
+		return false;
+	}
+
+	if (SOCK_CLOEXEC == 0)
+	{
+		fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+		fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+	}
+
+	std::cout.flush();
+	std::cerr.flush();
+	std::clog.flush();
+
+	fflush(stdout);
+	fflush(stderr);
+
+	BecomeSubreaper();
+
+	pid_t pid = fork();
+	if (pid < 0)
+	{
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+
+	if (pid == 0)
+	{
+		// Lead a process group: batched tests' descendants will join it.
+		setpgid(0, 0);
+
+		// Don't let this server's tests talk to (or read from) others.
+		CloseHiddenDescriptors();
+
+		close(fds[0]);
+		HideFromTests(fds[1]);
+		serve(fds[1]);
+	}
+
+	setpgid(pid, pid);
+
+	close(fds[1]);
+	HideFromTests(fds[0]);
+
+	if (not forkPerTest_)
+	{
+		out_->closeWriteEnd();
+		err_->closeWriteEnd();
+
+		out_->hideFromTests();
+		err_->hideFromTests();
+	}
+
+#ifdef SO_NOSIGPIPE
+	int on = 1;
+	setsockopt(fds[0], SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+
+	server_ = pid;
+	sock_ = fds[0];
+
+	return true;
+}
+
+
+TestResult PosixTestServer::kill(TestExitStatus reason)
+{
+	if (server_ > 0)
+		::kill(-server_, SIGKILL);
+
+	stop();
+
+	return capturedResult(reason, exitedUsage());
+}
+
+
+void PosixTestServer::stop()
+{
+	if (sock_ >= 0)
+	{
+		// Shut down (rather than just closing) the socket: other
+		// processes may hold copies of it, but the server must see EOF.
+		shutdown(sock_, SHUT_RDWR);
+		RevealToTests(sock_);
+		close(sock_);
+		sock_ = -1;
+	}
+
+	if (server_ > 0)
+	{
+		while (wait4(server_, &status_, 0, &rusage_) < 0
+		       and errno == EINTR)
+		{
+		}
+
+		strays_ = KillProcessGroup(server_);
+		server_ = -1;
+	}
+
+	busy_ = false;
+}
+
+
+vector<int> PosixTestServer::outputfds() const
+{
+	vector<int> fds;
+
+	if (out_ and out_->pollfd() >= 0)
+		fds.push_back(out_->pollfd());
+
+	if (err_ and err_->pollfd() >= 0)
+		fds.push_back(err_->pollfd());
+
+	return fds;
+}
+
+
+void PosixTestServer::drainOutput(size_t maximum)
+{
+	if (out_)
+		out_->drain(maximum);
+
+	if (err_)
+		err_->drain(maximum);
+}
+
+
+size_t PosixTestServer::outputSize() const
+{
+	return (out_ ? out_->total() : 0) + (err_ ? err_->total() : 0);
+}
+
+
+TestResult PosixTestServer::capturedResult(TestExitStatus status,
+                                           ResourceUsage usage)
+{
+	if (not out_ or not err_)
+	{
+		return TestResult(status, "", "", usage);
+	}
+
+	drainOutput();
+
+	return TestResult(status, out_->release(), err_->release(), usage);
+}
+
+
+ResourceUsage PosixTestServer::exitedUsage() const
+{
+	ResourceUsage usage = ConvertUsage(rusage_);
+	usage.wallTime = std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::steady_clock::now() - started_);
+	usage.strayProcesses = strays_;
+
+	return usage;
+}
+
+
+unique_ptr<ChildTest> PosixTestServer::start(size_t index,
+                                             const ChildLimits &limits)
+{
+	assert(not busy_);
+
+	// (Re)start the server if it isn't running.
+	if (server_ < 0 and not spawn())
+	{
+		return nullptr;
+	}
+
+	if (not forkPerTest_)
+	{
+		out_->clear(limits.outputHead, limits.outputTail);
+		err_->clear(limits.outputHead, limits.outputTail);
+	}
+
+	Request request;
+	request.index = static_cast<uint32_t>(index);
+	request.limits = limits;
+
+	if (not SendFully(sock_, &request, sizeof(request)))
+	{
+		stop();
+		return nullptr;
+	}
+
+	busy_ = true;
+	started_ = std::chrono::steady_clock::now();
+
+	return unique_ptr<ChildTest>(new ServerTest(*this, limits));
+}
+
+
+TestResult PosixTestServer::receive()
+{
+	assert(busy_);
+
+	Reply reply;
+	if (not ReadFully(sock_, &reply, sizeof(reply)))
+	{
+		stop();
+
+		// A fork server should never die: it only runs tests in
+		// its children. A batch server dies when a test fails,
+		// crashes, etc.: it will be replaced for the next test.
+		if (forkPerTest_)
+		{
+			return TestExitStatus::OtherError;
+		}
+
+		return capturedResult(ProcessChildStatus(status_),
+		                      exitedUsage());
+	}
+
+	if (not forkPerTest_)
+	{
+		// The server flushed its output before replying,
+		// so it's all waiting for us in the pipes.
+		busy_ = false;
+		return capturedResult(static_cast<TestExitStatus>(reply.status),
+		                      reply.usage);
+	}
+
+	string out(reply.outputLength, '\0');
+	string err(reply.errorLength, '\0');
+
+	if (not ReadFully(sock_, &out[0], out.size())
+	    or not ReadFully(sock_, &err[0], err.size()))
+	{
+		stop();
+		return TestExitStatus::OtherError;
+	}
+
+	busy_ = false;
+
+	return TestResult(static_cast<TestExitStatus>(reply.status),
+	                  std::move(out), std::move(err), reply.usage);
+}
+
+
+void PosixTestServer::serve(int sock)
+{
+	// Servers run sandboxed tests: enter the sandbox's namespaces once,
+	// here, rather than in every test process that we fork.
+	EnterSandboxNamespaces();
+
+	if (not forkPerTest_)
+	{
+		// Tests will run in this process: capture their output.
+		if (dup2(out_->writeEnd(), STDOUT_FILENO) < 0
+		    or dup2(err_->writeEnd(), STDERR_FILENO) < 0)
+		{
+			_exit(1);
+		}
+
+		out_.reset();
+		err_.reset();
+	}
+
+	Request request;
+	while (ReadFully(sock, &request, sizeof(request)))
+	{
+		unique_ptr<TestResult> result;
+
+		if (request.index >= tests_.size())
+		{
+			result.reset(new TestResult(TestExitStatus::OtherError));
+		}
+		else if (forkPerTest_)
+		{
+			result.reset(new TestResult(
+				forkTest(tests_[request.index],
+				         request.limits)));
+		}
+		else
+		{
+			result.reset(new TestResult(
+				runTest(tests_[request.index],
+				        request.limits)));
+		}
+
+		const OutputView out = result->outputView();
+		const OutputView err = result->errorOutputView();
+
+		Reply reply;
+		reply.status = static_cast<int32_t>(result->status);
+		reply.outputLength = static_cast<uint32_t>(out.size());
+		reply.errorLength = static_cast<uint32_t>(err.size());
+		reply.usage = result->usage;
+
+		if (not SendFully(sock, &reply, sizeof(reply))
+		    or not SendFully(sock, out.data(), out.size())
+		    or not SendFully(sock, err.data(), err.size()))
+		{
+			break;
+		}
+	}
+
+	// Don't run the test suite's atexit handlers or flush its buffers.
+	_exit(0);
+}
+
+
+TestResult PosixTestServer::forkTest(const TestClosure &test,
+                                     const ChildLimits &limits)
+{
+	// ForkChild() closes the (hidden) socket before running the test.
+	unique_ptr<ChildTest> child = StartTest(test, limits);
+	if (not child)
+	{
+		return TestExitStatus::OtherError;
+	}
+
+	return child->result();
+}
+
+
+TestResult PosixTestServer::runTest(const TestClosure &test,
+                                    const ChildLimits &limits)
+{
+	// Tests share this process: only set limits that the next test can lift.
+	if (not ApplyResourceLimits(limits, false))
+	{
+		exit(static_cast<int>(TestExitStatus::OtherError));
+	}
+
+	// Once the first test has entered the sandbox, we can't mount a private
+	// tmpfs: use an ordinary directory and return to where we were after.
+	int cwd = -1;
+	string scratch;
+	if (limits.scratchDirectory)
+	{
+		cwd = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+		scratch = CreateScratchDirectory(false);
+
+		if (cwd < 0 or scratch.empty() or chdir(scratch.c_str()) != 0)
+		{
+			exit(static_cast<int>(TestExitStatus::OtherError));
+		}
+	}
+
+	UsageMeter meter;
+	TestExitStatus status = RunInProcess(test, limits);
+
+	if (cwd >= 0)
+	{
+		if (fchdir(cwd) != 0)
+			exit(static_cast<int>(TestExitStatus::OtherError));
+
+		close(cwd);
+		DiscardScratchDirectory(scratch);
+	}
+
+	// A failed test may have left things in an unknown state: start afresh.
+	if (status != TestExitStatus::Pass)
+	{
+		exit(static_cast<int>(status));
+	}
+
+	// The test suite will read our output from the capture pipes.
+	std::cout.flush();
+	std::cerr.flush();
+	std::clog.flush();
+
+	fflush(stdout);
+	fflush(stderr);
+
+	return TestResult(status, "", "", meter.elapsed());
+}
+
+
+vector<int> ServerTest::pollfds() const
+{
+	vector<int> fds = server_.outputfds();
+
+	if (server_.socket() >= 0)
+		fds.push_back(server_.socket());
+
+	return fds;
+}
+
+
+int ServerTest::msUntilDeadline() const
+{
+	if (not enforcingLimits() or limits_.timeout == Timeout::zero())
+		return -1;
+
+	const Clock::duration remaining = deadline_ - Clock::now();
+	if (remaining <= Clock::duration::zero())
+		return 0;
+
+	// Round up: waking before the deadline would only make us sleep again.
+	auto ms = std::chrono::duration_cast<Timeout>(remaining);
+	if (ms < remaining)
+		ms += Timeout(1);
+
+	return static_cast<int>(ms.count());
+}
+
+
+bool ServerTest::done()
+{
+	if (result_)
+		return true;
+
+	// A server that has been stopped has no socket: that's an error.
+	if (server_.socket() < 0)
+	{
+		result_.reset(new TestResult(TestExitStatus::OtherError));
+		return true;
+	}
+
+	if (enforcingLimits())
+	{
+		// Read a bounded amount, as in PosixChildTest::drain().
+		server_.drainOutput(64 * 1024);
+
+		if (limits_.outputLimit != 0
+		    and server_.outputSize() > limits_.outputLimit)
+		{
+			result_.reset(new TestResult(
+				server_.kill(TestExitStatus::OutputLimit)));
+
+			return true;
+		}
+	}
+
+	struct pollfd pfd;
+	pfd.fd = server_.socket();
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	if (poll(&pfd, 1, 0) == 0)
+	{
+		if (enforcingLimits() and limits_.timeout != Timeout::zero()
+		    and Clock::now() >= deadline_)
+		{
+			result_.reset(new TestResult(
+				server_.kill(TestExitStatus::Timeout)));
+
+			return true;
+		}
+
+		return false;
+	}
+
+	TestResult result = server_.receive();
+
+	// The test may have exceeded its output limit just before finishing.
+	if (enforcingLimits() and limits_.outputLimit != 0
+	    and server_.outputSize() > limits_.outputLimit)
+	{
+		result_.reset(
+			new TestResult(TestExitStatus::OutputLimit, result));
+	}
+	else
+	{
+		result_.reset(new TestResult(result));
+	}
+
+	return true;
+}
+
+
+TestResult ServerTest::result()
+{
+	while (not done())
+	{
+		WaitForAny({ this });
+	}
+
+	return *result_;
+}
+
+
+unique_ptr<TestServer> grading::StartForkServer(vector<TestClosure> tests)
+{
+	unique_ptr<PosixTestServer> server(
+		new PosixTestServer(std::move(tests), true));
+
+	if (not server->spawn())
+	{
+		return nullptr;
+	}
+
+	return std::move(server);
+}
+
+
+unique_ptr<TestServer> grading::StartBatchServer(vector<TestClosure> tests)
+{
+	unique_ptr<PosixTestServer> server(
+		new PosixTestServer(std::move(tests), false));
+
+	if (not server->spawn())
+	{
+		return nullptr;
+	}
+
+	return std::move(server);
+}
@@ -0,0 +1,134 @@
+/*!
+ * @file      allocations.cpp
+ * @brief     Test allocation tracking in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include "private.h"
+
+#include <cassert>
+#include <vector>
+
+using namespace grading;
+using namespace std;
+
+
+//! Somewhere to put allocations so that the compiler can't elide them.
+static int* volatile sink;
+
+
+//! Fill a vector, optionally reserving space for it first.
+static void Fill(size_t n, bool reserve)
+{
+	vector<int> v;
+	if (reserve)
+		v.reserve(n);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		v.push_back(static_cast<int>(i));
+	}
+
+	sink = v.data();
+}
+
+
+int main(int argc, char* argv[])
+{
+	TestSuite tests;
+
+	tests.add(TestBuilder("reserved")
+		.description(" - one allocation, freed")
+		.test([]() { Fill(1000, true); })
+		.maxAllocations(1)
+		.forbidLeaks()
+	);
+
+	tests.add(TestBuilder("grown")
+		.description(" - should fail: the vector is repeatedly reallocated")
+		.test([]() { Fill(1000, false); })
+		.maxAllocations(1)
+	);
+
+	tests.add(TestBuilder("too big")
+		.description(" - should fail: too much memory live at once")
+		.test([]() { Fill(100000, true); })
+		.maxAllocatedBytes(1024)
+	);
+
+	tests.add(TestBuilder("leaky")
+		.description(" - should fail: memory is leaked")
+		.test([]() { sink = new int[16]; })
+		.forbidLeaks()
+	);
+
+	tests.add(TestBuilder("tracked")
+		.description(" - statistics only")
+		.test([]() { sink = new int[16]; })
+		.trackAllocations()
+	);
+
+	TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 5 and stats.passed == 2);
+
+	// Statistics are counted in the test's process.
+	const TestResult leaky = TestBuilder("leaky")
+		.test([]() { sink = new int[16]; Fill(1000, true); })
+		.trackAllocations()
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	const AllocationStatistics &a = leaky.allocations;
+	assert(leaky.status == TestExitStatus::Pass);
+	assert(a.tracked);
+	assert(a.allocations == 2 and a.deallocations == 1);
+	assert(a.bytes == 16 * sizeof(int) + 1000 * sizeof(int));
+	assert(a.peakBytes >= a.bytes);
+	assert(a.leakedBlocks == 1 and a.leakedBytes >= 16 * sizeof(int));
+
+	const TestResult grown = TestBuilder("grown")
+		.test([]() { Fill(1000, false); })
+		.maxAllocations(1)
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	assert(grown.status == TestExitStatus::Fail);
+	assert(grown.allocations.allocations > 1);
+	assert(grown.allocations.leakedBlocks == 0);
+
+	// Tests that don't track their allocations don't report any.
+	const TestResult untracked = TestBuilder("untracked")
+		.test([]() { Fill(1000, false); })
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	assert(not untracked.allocations.tracked);
+	assert(untracked.allocations.allocations == 0);
+
+	// Without anywhere to count allocations, the test can't run at all.
+	const TestResult nowhere = TestBuilder("nowhere to count")
+		.test(AllocationClosure([]() { Fill(1000, true); }, 0, 0, false,
+		                        nullptr))
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	assert(nowhere.status == TestExitStatus::OtherError);
+
+	return 0;
+}
@@ -0,0 +1,113 @@
+/*!
+ * @file      benchmark.cpp
+ * @brief     Test benchmark tests in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include "private.h"
+
+#include <cassert>
+#include <cmath>
+
+using namespace grading;
+using namespace std;
+
+
+//! Do some work that the compiler can't optimize away.
+static void Work(unsigned int n)
+{
+	volatile unsigned long sum = 0;
+	for (unsigned int i = 0; i < n; i++)
+	{
+		sum = sum + i;
+	}
+}
+
+
+//! Check the statistics that benchmarks are summarized with.
+static void CheckSummaries()
+{
+	// An obvious outlier is rejected before the median and MAD are found.
+	SampleSummary s = Summarize({ 12, 100, 10, 14, 11, 13 });
+	assert(s.outliers == 1);
+	assert(s.median == 12 and s.mad == 1);
+
+	// With no spread at all, nothing is an outlier.
+	s = Summarize({ 5, 5, 5, 5 });
+	assert(s.outliers == 0 and s.median == 5 and s.mad == 0);
+
+	// With a MAD of zero, anything different is an outlier.
+	s = Summarize({ 5, 5, 6, 5, 5 });
+	assert(s.outliers == 1 and s.median == 5 and s.mad == 0);
+}
+
+
+int main(int argc, char* argv[])
+{
+	CheckSummaries();
+
+	auto reference = []() { Work(1000); };
+
+	TestSuite tests;
+
+	tests.add(TestBuilder("fast enough")
+		.description(" - as fast as the reference")
+		.benchmark([]() { Work(1000); }, reference, 3)
+	);
+
+	tests.add(TestBuilder("too slow")
+		.description(" - should fail: twenty times slower than the reference")
+		.benchmark([]() { Work(20000); }, reference, 2)
+	);
+
+	tests.add(TestBuilder("incorrect")
+		.description(" - should fail before benchmarking")
+		.test([]() { Fail("wrong answer"); })
+		.benchmark([]() { Work(1000); }, reference)
+	);
+
+	// Timings on a busy machine can go either way: only the incorrect
+	// test is certain to fail.
+	TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 3 and stats.failed >= 1);
+
+	// Statistics are collected from the test's process.
+	const Test slow = TestBuilder("too slow")
+		.benchmark([]() { Work(20000); }, reference, 2, 9)
+		.build();
+
+	const TestResult result = slow.Run(TestRunStrategy::Separated);
+	const BenchmarkStatistics &b = result.benchmark;
+
+	assert(result.status == TestExitStatus::Pass
+	       or result.status == TestExitStatus::Fail);
+	assert(b.samples == 9 and b.iterations >= 9 and b.outliers < 9);
+	assert(b.median.count() > 0 and b.referenceMedian.count() > 0);
+	assert(std::isfinite(b.ratio) and b.ratio > 0);
+
+	// A test that fails its correctness check never gets that far.
+	const Test incorrect = TestBuilder("incorrect")
+		.test([]() { Fail("wrong answer"); })
+		.benchmark([]() { Work(1000); }, reference)
+		.build();
+
+	assert(incorrect.Run(TestRunStrategy::Separated).benchmark.samples == 0);
+
+	return 0;
+}
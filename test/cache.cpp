@@ -0,0 +1,139 @@
+/*!
+ * @file      cache.cpp
+ * @brief     Test the on-disk result cache in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Run a test suite with the given arguments (after argv[0]).
+static TestSuite::Statistics Run(const TestSuite &tests, const char *argv0,
+                                 vector<string> args)
+{
+	args.insert(args.begin(), argv0);
+
+	vector<char*> argv;
+	for (string &a : args)
+	{
+		argv.push_back(&a[0]);
+	}
+	argv.push_back(nullptr);
+
+	return tests.Run(static_cast<int>(args.size()), argv.data());
+}
+
+
+//! Count the lines in a file (or return 0 if it doesn't exist).
+static int CountLines(const string &filename)
+{
+	FILE *f = fopen(filename.c_str(), "r");
+	if (not f)
+		return 0;
+
+	int lines = 0;
+	for (int c = fgetc(f); c != EOF; c = fgetc(f))
+	{
+		if (c == '\n')
+			lines++;
+	}
+
+	fclose(f);
+	return lines;
+}
+
+
+int main(int argc, char* argv[])
+{
+	const string prefix = "/tmp/libgrading-cache." + to_string(getpid());
+	const string cache = prefix + ".d";
+	const string log = prefix + ".log";
+
+	// Each test leaves a line in a log file whenever it actually runs.
+	auto logRun = [log]()
+	{
+		FILE *f = fopen(log.c_str(), "a");
+		CheckNonNull(f, "fopen()");
+		fputs("ran\n", f);
+		fclose(f);
+	};
+
+	TestSuite tests;
+
+	tests.add(TestBuilder("pass")
+		.description(" - should pass")
+		.test([logRun]() { logRun(); cout << "some output\n"; })
+	);
+
+	tests.add(TestBuilder("fail")
+		.description(" - should fail (and be cached as a failure)")
+		.test([logRun]() { logRun(); Fail("expected failure"); })
+	);
+
+	tests.add(TestBuilder("another pass")
+		.description(" - should pass")
+		.test([logRun]() { logRun(); })
+	);
+
+	// This test doesn't log its runs: on a busy machine, it could time out
+	// before it gets that far.
+	tests.add(TestBuilder("timeout")
+		.description(" - should time out (and not be cached)")
+		.timeout(Timeout(10))
+		.test([]() { usleep(200000); })
+	);
+
+	vector<string> args(argv + 1, argv + argc);
+	args.push_back("--cache=" + cache);
+
+	// The first run fills the cache.
+	TestSuite::Statistics stats = Run(tests, argv[0], args);
+	assert(stats.total == 4 and stats.passed == 2);
+	assert(stats.cacheHits == 0 and stats.cacheMisses == 4);
+	assert(CountLines(log) == 3);
+
+	// The second run should only run the test that timed out (which might
+	// not time out next time), but should get the same results.
+	stats = Run(tests, argv[0], args);
+	assert(stats.total == 4 and stats.passed == 2);
+	assert(stats.cacheHits == 3 and stats.cacheMisses == 1);
+	assert(CountLines(log) == 3);
+
+	// A different submission needs its own results.
+	args.push_back("--submission=another-student");
+	stats = Run(tests, argv[0], args);
+	assert(stats.total == 4 and stats.passed == 2);
+	assert(stats.cacheHits == 0 and stats.cacheMisses == 4);
+	assert(CountLines(log) == 6);
+
+	remove(log.c_str());
+	const string cleanup = "rm -rf '" + cache + "'";
+	assert(system(cleanup.c_str()) == 0);
+
+	return 0;
+}
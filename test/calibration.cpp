@@ -0,0 +1,143 @@
+/*!
+ * @file      calibration.cpp
+ * @brief     Test timeout calibration in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Run a test suite with the given arguments (after argv[0]).
+static TestSuite::Statistics Run(const TestSuite &tests, const char *argv0,
+                                 vector<string> args)
+{
+	args.insert(args.begin(), argv0);
+
+	vector<char*> argv;
+	for (string &a : args)
+	{
+		argv.push_back(&a[0]);
+	}
+	argv.push_back(nullptr);
+
+	return tests.Run(static_cast<int>(args.size()), argv.data());
+}
+
+
+
+//! Read a file's lines (or nothing, if it doesn't exist).
+static vector<string> ReadLines(const string &filename)
+{
+	vector<string> lines;
+
+	ifstream in(filename);
+	for (string line; getline(in, line); )
+	{
+		lines.push_back(line);
+	}
+
+	return lines;
+}
+
+
+int main(int argc, char* argv[])
+{
+	const string profile =
+		"/tmp/libgrading-timeouts." + to_string(getpid());
+
+	TestSuite tests;
+
+	// This test's hand-tuned timeout is far too tight.
+	tests.add(TestBuilder("sleepy")
+		.description(" - should take about 200 ms")
+		.timeout(Timeout(10))
+		.test([]() { usleep(200000); })
+	);
+
+	tests.add(TestBuilder("quick")
+		.description(" - should pass")
+		.test([]() {})
+	);
+
+	vector<string> args(argv + 1, argv + argc);
+
+	// With its own timeout, "sleepy" times out.
+	TestSuite::Statistics stats = Run(tests, argv[0], args);
+	assert(stats.total == 2 and stats.passed == 1);
+
+	// Calibrating runs tests without their own timeouts.
+	vector<string> calibrate = args;
+	calibrate.push_back("--calibrate=" + profile);
+	calibrate.push_back("--calibration-runs=3");
+
+	stats = Run(tests, argv[0], calibrate);
+	assert(stats.total == 2 and stats.passed == 2);
+
+	// Timeouts should be a multiple of tests' durations, plus a floor.
+	const vector<string> lines = ReadLines(profile);
+	assert(lines.size() == 3);
+	assert(lines[0] == "libgrading-timeouts 1");
+
+	for (size_t i = 1; i < lines.size(); i++)
+	{
+		const long ms = stol(lines[i]);
+		const string name = lines[i].substr(lines[i].find(' ') + 1);
+
+		assert(name == "quick" or name == "sleepy");
+		assert(ms >= ((name == "sleepy") ? 1150 : 1000));
+	}
+
+	// Calibrated timeouts replace tests' own...
+	vector<string> calibrated = args;
+	calibrated.push_back("--timeout-profile=" + profile);
+
+	stats = Run(tests, argv[0], calibrated);
+	assert(stats.total == 2 and stats.passed == 2);
+
+	// ... but the suite-wide timeout still applies (with plenty of room
+	// for "quick", even on a busy machine).
+	calibrated.push_back("--timeout=100ms");
+
+	stats = Run(tests, argv[0], calibrated);
+	assert(stats.total == 2 and stats.passed == 1);
+
+	// Tests that are cut short while calibrating aren't profiled: how
+	// long they took says little about how long they need.
+	calibrate.push_back("--timeout=100ms");
+
+	stats = Run(tests, argv[0], calibrate);
+	assert(stats.total == 2 and stats.passed == 1);
+
+	const vector<string> truncated = ReadLines(profile);
+	assert(truncated.size() == 2);
+	assert(truncated[1].substr(truncated[1].find(' ') + 1) == "quick");
+
+	remove(profile.c_str());
+
+	return 0;
+}
@@ -0,0 +1,193 @@
+/*!
+ * @file      complexity.cpp
+ * @brief     Test complexity tests in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include "private.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+
+using namespace grading;
+using namespace std;
+
+
+//! Do O(n) work that the compiler can't optimize away.
+static void Linear(size_t n)
+{
+	volatile unsigned long sum = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		sum = sum + i;
+	}
+}
+
+
+//! Do O(n^2) work that the compiler can't optimize away.
+static void Quadratic(size_t n)
+{
+	volatile unsigned long sum = 0;
+	for (size_t i = 0; i < n; i++)
+	{
+		for (size_t j = 0; j < n; j++)
+		{
+			sum = sum + j;
+		}
+	}
+}
+
+
+//! Fit complexity classes to made-up times (in ns).
+static ComplexityStatistics Fit(const vector<size_t> &sizes,
+                                const vector<long long> &times)
+{
+	ComplexityStatistics c;
+	c.sizes = sizes;
+	for (long long t : times)
+	{
+		c.times.emplace_back(t);
+	}
+
+	FitComplexity(c);
+	return c;
+}
+
+
+//! Check fits against costs that don't depend on how busy the machine is.
+static void CheckFits()
+{
+	const vector<size_t> sizes = { 1000, 2000, 4000, 8000, 16000 };
+
+	// A fixed overhead is fitted as the intercept, not as slower growth.
+	ComplexityStatistics c =
+		Fit(sizes, { 53000, 56000, 62000, 74000, 98000 });
+
+	assert(c.fitted == Complexity::Linear);
+	assert(fabs(c.intercept - 50000) < 1 and fabs(c.coefficient - 3) < 1e-6);
+	assert(c.error < 1e-6);
+
+	c = Fit({ 250, 500, 1000, 2000 },
+	        { 7250, 26000, 101000, 401000 });
+
+	assert(c.fitted == Complexity::Quadratic);
+	assert(fabs(c.intercept - 1000) < 1 and fabs(c.coefficient - 0.1) < 1e-6);
+
+	// Noise shouldn't make a constant or linear cost look any worse.
+	c = Fit({ 250, 500, 1000, 2000 }, { 100, 102, 99, 101 });
+	assert(c.fitted == Complexity::Constant);
+	assert(fabs(c.intercept - 100.5) < 1e-6 and c.coefficient == 0);
+
+	c = Fit(sizes, { 1030, 1940, 4080, 7840, 16480 });
+	assert(c.fitted == Complexity::Linear);
+	assert(c.intercept >= 0 and c.error < 0.05);
+
+	// Instruction counts are fitted instead of times when there are some.
+	c = Fit(sizes, { 100, 100, 100, 100, 100 });
+	c.metric = ComplexityMetric::Instructions;
+	c.instructions = { 1000000, 4000000, 16000000, 64000000, 256000000 };
+	FitComplexity(c);
+
+	assert(c.fitted == Complexity::Quadratic);
+	assert(fabs(c.coefficient - 1) < 1e-6 and c.error < 1e-6);
+}
+
+
+int main(int argc, char* argv[])
+{
+	CheckFits();
+
+	const vector<size_t> large = { 100000, 200000, 400000, 800000 };
+	const vector<size_t> small = { 250, 500, 1000, 2000 };
+
+	TestSuite tests;
+
+	tests.add(TestBuilder("linear")
+		.description(" - O(n), as expected")
+		.complexity(Linear, large, Complexity::Linear)
+	);
+
+	tests.add(TestBuilder("better than expected")
+		.description(" - O(n), better than the expected O(n^2)")
+		.complexity(Linear, large, Complexity::Quadratic)
+	);
+
+	tests.add(TestBuilder("quadratic")
+		.description(" - should fail: O(n^2) rather than O(n log n)")
+		.complexity(Quadratic, small, Complexity::Linearithmic,
+		            ComplexityMetric::Instructions)
+	);
+
+	// Times on a busy machine can fit almost anything: only check that
+	// every test ran to a verdict.
+	TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 3 and stats.passed + stats.failed == 3);
+
+	// Costs are measured in the test's process (or its children).
+	const TestResult quadratic = TestBuilder("quadratic")
+		.complexity(Quadratic, small, Complexity::Linearithmic,
+		            ComplexityMetric::Instructions)
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	const ComplexityStatistics &c = quadratic.complexity;
+	assert(quadratic.status == TestExitStatus::Pass
+	       or quadratic.status == TestExitStatus::Fail);
+	assert(c.sizes == small and c.times.size() == small.size());
+	assert(c.expected == Complexity::Linearithmic);
+	assert(c.coefficient >= 0 and c.intercept >= 0 and isfinite(c.error));
+
+	// Instruction counts (where they can be counted) are repeatable.
+	if (c.metric == ComplexityMetric::Instructions)
+	{
+		assert(c.instructions.size() == small.size());
+		assert(c.fitted == Complexity::Quadratic);
+		assert(quadratic.status == TestExitStatus::Fail);
+	}
+	else
+	{
+		assert(c.instructions.empty());
+	}
+
+	// Empty inputs can't be fitted (log 0 isn't finite): they're ignored.
+	vector<size_t> withEmpty = large;
+	withEmpty.insert(withEmpty.begin(), 0);
+
+	const TestResult empty = TestBuilder("empty input")
+		.complexity(Linear, withEmpty, Complexity::Linear)
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	assert(empty.complexity.sizes == large);
+	assert(isfinite(empty.complexity.coefficient));
+	assert(isfinite(empty.complexity.error));
+
+	// Each size is measured in a process of its own: a crash at one size
+	// fails the test rather than the test suite.
+	const TestResult crash = TestBuilder("crash")
+		.complexity([](size_t n) { if (n > 500) abort(); }, small,
+		            Complexity::Cubic)
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	assert(crash.status == TestExitStatus::Fail);
+
+	return 0;
+}
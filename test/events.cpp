@@ -0,0 +1,103 @@
+/*!
+ * @file      events.cpp
+ * @brief     Test event counting in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+
+using namespace grading;
+using namespace std;
+
+
+//! Do some work that the compiler can't optimize away.
+static void Work(unsigned int n)
+{
+	volatile unsigned long sum = 0;
+	for (unsigned int i = 0; i < n; i++)
+	{
+		sum = sum + i;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	TestSuite tests;
+
+	tests.add(TestBuilder("counted")
+		.description(" - events are counted (where the system allows)")
+		.test([]() { Work(1000000); })
+		.countEvents()
+	);
+
+	tests.add(TestBuilder("uncounted")
+		.description(" - no events are counted")
+		.test([]() { Work(1000000); })
+	);
+
+	TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 2 and stats.passed == 2);
+
+	// Tests that don't ask for counters don't get any.
+	const EventCounts none = TestBuilder("uncounted")
+		.test([]() { Work(1000000); })
+		.build()
+		.Run(TestRunStrategy::Separated)
+		.usage.events;
+
+	assert(none.instructions == -1 and none.cycles == -1);
+	assert(none.cacheMisses == -1 and none.branchMisses == -1);
+	assert(none.taskClock == -1 and none.pageFaults == -1);
+
+	// Not every system lets us count every event (or any events at all),
+	// but those that we can count should scale with the test's work.
+	const EventCounts little = TestBuilder("little")
+		.test([]() { Work(1000000); })
+		.countEvents()
+		.build()
+		.Run(TestRunStrategy::Separated)
+		.usage.events;
+
+	const EventCounts lots = TestBuilder("lots")
+		.test([]() { Work(10000000); })
+		.countEvents()
+		.build()
+		.Run(TestRunStrategy::Separated)
+		.usage.events;
+
+	if (little.instructions >= 0)
+	{
+		assert(little.instructions >= 1000000);
+		assert(lots.instructions > 5 * little.instructions);
+	}
+
+	if (little.taskClock >= 0)
+	{
+		assert(little.taskClock > 0);
+		assert(lots.taskClock > little.taskClock);
+	}
+
+	if (little.pageFaults >= 0)
+	{
+		assert(lots.pageFaults >= 0);
+	}
+
+	return 0;
+}
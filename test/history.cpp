@@ -0,0 +1,127 @@
+/*!
+ * @file      history.cpp
+ * @brief     Test longest-first scheduling from test history in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Run a test suite with the given arguments (after argv[0]).
+static TestSuite::Statistics Run(const TestSuite &tests, const char *argv0,
+                                 vector<string> args)
+{
+	args.insert(args.begin(), argv0);
+
+	vector<char*> argv;
+	for (string &a : args)
+	{
+		argv.push_back(&a[0]);
+	}
+	argv.push_back(nullptr);
+
+	return tests.Run(static_cast<int>(args.size()), argv.data());
+}
+
+
+
+//! Read a file's lines (or nothing, if it doesn't exist).
+static vector<string> ReadLines(const string &filename)
+{
+	vector<string> lines;
+
+	ifstream in(filename);
+	for (string line; getline(in, line); )
+	{
+		lines.push_back(line);
+	}
+
+	return lines;
+}
+
+
+int main(int argc, char* argv[])
+{
+	const string prefix = "/tmp/libgrading-history." + to_string(getpid());
+	const string history = prefix + ".history";
+	const string log = prefix + ".log";
+
+	// Each test logs its name when it starts running.
+	auto test = [log](string name)
+	{
+		return TestBuilder(name)
+			.test([log, name]()
+			{
+				ofstream(log, ios::app) << name << "\n";
+			});
+	};
+
+	TestSuite tests;
+	tests.add(test("a"));
+	tests.add(test("b"));
+	tests.add(test("c"));
+	tests.add(test("d"));
+	tests.add(test("e").after("a"));
+	tests.add(test("f"));
+
+	// "f" hasn't been seen before, so it's assumed to be long.
+	ofstream(history)
+		<< "libgrading-history 1\n"
+		<< "100000 a\n"
+		<< "200000 b\n"
+		<< "300000 c\n"
+		<< "400000 d\n"
+		<< "1000000 e\n"
+		;
+
+	vector<string> args(argv + 1, argv + argc);
+	args.push_back("--history=" + history);
+
+	// "a" leads to the most work (via "e"), then "e" and "f" are longest.
+	TestSuite::Statistics stats = Run(tests, argv[0], args);
+	assert(stats.total == 6 and stats.passed == 6);
+	assert(ReadLines(log)
+		== vector<string>({ "a", "e", "f", "d", "c", "b" }));
+
+	// Every test's duration should now be in the history.
+	assert(ReadLines(history).size() == 7);
+
+	// With --suite-order, tests start in suite order (after prerequisites).
+	remove(log.c_str());
+	args.push_back("--suite-order");
+
+	stats = Run(tests, argv[0], args);
+	assert(stats.total == 6 and stats.passed == 6);
+	assert(ReadLines(log)
+		== vector<string>({ "a", "b", "c", "d", "e", "f" }));
+
+	remove(log.c_str());
+	remove(history.c_str());
+
+	return 0;
+}
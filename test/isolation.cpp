@@ -0,0 +1,62 @@
+/*!
+ * @file      isolation.cpp
+ * @brief     Test that tests can't reach the test suite or its servers.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Fail if this process holds any sockets (e.g., a test server's).
+static void CheckNoSockets()
+{
+	const int limit = static_cast<int>(sysconf(_SC_OPEN_MAX));
+
+	for (int fd = STDERR_FILENO + 1; fd < limit and fd < 4096; fd++)
+	{
+		struct stat s;
+		const bool socket = (fstat(fd, &s) == 0 and S_ISSOCK(s.st_mode));
+		Check(not socket, "descriptor " + to_string(fd) + " isn't a socket");
+	}
+}
+
+
+const TestSuite tests =
+{
+	{ "first", " - runs alongside the second", CheckNoSockets },
+	{ "second", " - runs alongside the first", CheckNoSockets },
+	{ "third", " - runs after a server has been reused", CheckNoSockets },
+	{ "fourth", " - runs after a server has been reused", CheckNoSockets },
+};
+
+
+int main(int argc, char* argv[])
+{
+	const TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 4);
+	assert(stats.passed == 4);
+
+	return 0;
+}
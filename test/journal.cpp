@@ -0,0 +1,172 @@
+/*!
+ * @file      journal.cpp
+ * @brief     Test resumable result journals in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Run a test suite with the given arguments (after argv[0]).
+static TestSuite::Statistics Run(const TestSuite &tests, const char *argv0,
+                                 vector<string> args)
+{
+	args.insert(args.begin(), argv0);
+
+	vector<char*> argv;
+	for (string &a : args)
+	{
+		argv.push_back(&a[0]);
+	}
+	argv.push_back(nullptr);
+
+	return tests.Run(static_cast<int>(args.size()), argv.data());
+}
+
+
+//! Count the lines in a file (or return 0 if it doesn't exist).
+static int CountLines(const string &filename)
+{
+	FILE *f = fopen(filename.c_str(), "r");
+	if (not f)
+		return 0;
+
+	int lines = 0;
+	for (int c = fgetc(f); c != EOF; c = fgetc(f))
+	{
+		if (c == '\n')
+			lines++;
+	}
+
+	fclose(f);
+	return lines;
+}
+
+
+int main(int argc, char* argv[])
+{
+	const string prefix = "/tmp/libgrading-journal." + to_string(getpid());
+	const string journal = prefix + ".journal";
+	const string log = prefix + ".log";
+
+	// Each test leaves a line in a log file whenever it actually runs.
+	auto logRun = [log]()
+	{
+		FILE *f = fopen(log.c_str(), "a");
+		CheckNonNull(f, "fopen()");
+		fputs("ran\n", f);
+		fclose(f);
+	};
+
+	auto pass = [logRun]() { logRun(); cout << "some output\n"; };
+	auto fail = [logRun]() { logRun(); Fail("expected failure"); };
+
+	TestSuite firstTwo;
+
+	firstTwo.add(TestBuilder("pass")
+		.description(" - should pass")
+		.test(pass)
+	);
+
+	firstTwo.add(TestBuilder("fail")
+		.description(" - should fail (and be journalled as a failure)")
+		.test(fail)
+	);
+
+	TestSuite tests = firstTwo;
+	tests.add(TestBuilder("another pass")
+		.description(" - should pass")
+		.test(logRun)
+	);
+
+	// The same suite, but with a different last test.
+	TestSuite renamed = firstTwo;
+	renamed.add(TestBuilder("renamed pass")
+		.description(" - should pass")
+		.test(logRun)
+	);
+
+	vector<string> args(argv + 1, argv + argc);
+	args.push_back("--journal=" + journal);
+
+	// The first run journals every result.
+	TestSuite::Statistics stats = Run(tests, argv[0], args);
+	assert(stats.total == 3 and stats.passed == 2);
+	assert(CountLines(log) == 3);
+
+	// Simulate an interruption partway through writing another result.
+	FILE *f = fopen(journal.c_str(), "a");
+	CheckNonNull(f, "fopen()");
+	fputs("1 fail 0.1 0.1 0 1024 0 0 0 0 0 100 0\npartial outp", f);
+	fclose(f);
+
+	// Resuming shouldn't run anything, but should get the same results.
+	vector<string> resume = args;
+	resume.push_back("--resume");
+
+	stats = Run(tests, argv[0], resume);
+	assert(stats.total == 3 and stats.passed == 2);
+	assert(CountLines(log) == 3);
+
+	// Resuming a journal that's missing a result should run only the
+	// missing test.
+	stats = Run(firstTwo, argv[0], args);
+	assert(stats.total == 2 and stats.passed == 1);
+	assert(CountLines(log) == 5);
+
+	stats = Run(tests, argv[0], resume);
+	assert(stats.total == 3 and stats.passed == 2);
+	assert(CountLines(log) == 6);
+
+	// Results for tests that have since changed shouldn't be reused.
+	stats = Run(renamed, argv[0], resume);
+	assert(stats.total == 3 and stats.passed == 2);
+	assert(CountLines(log) == 7);
+
+	stats = Run(tests, argv[0], resume);
+	assert(stats.total == 3 and stats.passed == 2);
+	assert(CountLines(log) == 8);
+
+	// Results from a different submission shouldn't be reused either.
+	vector<string> other = resume;
+	other.push_back("--submission=someone else");
+
+	stats = Run(tests, argv[0], other);
+	assert(stats.total == 3 and stats.passed == 2);
+	assert(CountLines(log) == 11);
+
+	// Without --resume, the journal starts again from scratch.
+	stats = Run(tests, argv[0], args);
+	assert(stats.total == 3 and stats.passed == 2);
+	assert(CountLines(log) == 14);
+
+	remove(log.c_str());
+	remove(journal.c_str());
+
+	return 0;
+}
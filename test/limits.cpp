@@ -0,0 +1,182 @@
+/*!
+ * @file      limits.cpp
+ * @brief     Test operating system resource limits in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <map>
+#include <new>
+#include <regex>
+#include <sstream>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Run a test suite, noting each test's reported result (in verbose output).
+static map<string, string> Run(const TestSuite &tests, int argc, char *argv[],
+                               TestSuite::Statistics &stats)
+{
+	// Tests inherit cout's buffer: redirect the descriptor beneath it.
+	FILE *f = tmpfile();
+	assert(f != nullptr);
+
+	cout.flush();
+	const int stdout_fd = dup(STDOUT_FILENO);
+	dup2(fileno(f), STDOUT_FILENO);
+
+	stats = tests.Run(argc, argv);
+
+	cout.flush();
+	dup2(stdout_fd, STDOUT_FILENO);
+	close(stdout_fd);
+
+	ostringstream out;
+	rewind(f);
+	for (int c; (c = fgetc(f)) != EOF; )
+	{
+		out.put(static_cast<char>(c));
+	}
+	fclose(f);
+
+	cout << out.str();
+
+	const regex test("Running test: '([^']*)'\\.");
+	const regex result("Result: (.*)");
+
+	map<string, string> results;
+	istringstream lines(out.str());
+	string line, name;
+	smatch match;
+
+	while (getline(lines, line))
+	{
+		if (regex_match(line, match, test))
+			name = match[1];
+
+		else if (regex_match(line, match, result))
+			results[name] = match[1];
+	}
+
+	return results;
+}
+
+
+int main(int argc, char* argv[])
+{
+	TestSuite tests;
+
+	tests.add(TestBuilder("memory hog")
+		.description(" - should run out of memory")
+		.test([]()
+		{
+			vector<vector<char>> chunks;
+			while (true)
+			{
+				chunks.emplace_back(16 << 20, 'x');
+			}
+		})
+		.memoryLimit(256 << 20)
+		.timeout(10)
+	);
+
+	tests.add(TestBuilder("CPU hog")
+		.description(" - should exceed its CPU time limit")
+		.test([]()
+		{
+			volatile unsigned long n = 0;
+			while (true)
+			{
+				n++;
+			}
+		})
+		.cpuLimit(std::chrono::seconds(1))
+		.timeout(10)
+	);
+
+	tests.add(TestBuilder("big file")
+		.description(" - should exceed its file size limit")
+		.test([]()
+		{
+			FILE *f = tmpfile();
+			assert(f != nullptr);
+
+			const string data(1 << 20, 'x');
+			fwrite(data.data(), 1, data.size(), f);
+			fflush(f);
+			fclose(f);
+		})
+		.fileSizeLimit(64 << 10)
+		.timeout(10)
+	);
+
+	tests.add(TestBuilder("bad_alloc")
+		.description(" - throws std::bad_alloc without a memory limit")
+		.test([]()
+		{
+			throw std::bad_alloc();
+		})
+		.timeout(10)
+	);
+
+	tests.add(TestBuilder("orphaned process")
+		.description(" - should pass, leaving a process to be killed")
+		.test([]()
+		{
+			if (fork() == 0)
+			{
+				sleep(60);
+				_exit(0);
+			}
+		})
+		.timeout(10)
+	);
+
+	tests.add(TestBuilder("modest test")
+		.description(" - should pass within its limits")
+		.test([]()
+		{
+			vector<char> v(1 << 20, 'x');
+			cout << "allocated " << v.size() << " bytes\n";
+		})
+		.memoryLimit(256 << 20)
+		.cpuLimit(std::chrono::seconds(5))
+		.fileSizeLimit(64 << 10)
+		.timeout(10)
+	);
+
+	TestSuite::Statistics stats;
+	map<string, string> results = Run(tests, argc, argv, stats);
+
+	assert(stats.total == 6);
+	assert(stats.passed == 2);
+	assert(stats.failed == 4);
+
+	assert(results["memory hog"] == "out of memory");
+	assert(results["CPU hog"] == "CPU time limit exceeded");
+	assert(results["big file"] == "file size limit exceeded");
+	assert(results["bad_alloc"] == "uncaught exception");
+
+	return 0;
+}
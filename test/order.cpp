@@ -0,0 +1,113 @@
+/*!
+ * @file      order.cpp
+ * @brief     Test that results are reported in the same order however
+ *            a test suite is run.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <regex>
+#include <sstream>
+#include <vector>
+
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Run a test suite with some arguments, capturing what it reports.
+static string Run(const TestSuite &tests, vector<string> args)
+{
+	args.insert(args.begin(), "test-order");
+
+	vector<char*> argv;
+	for (string &arg : args)
+	{
+		argv.push_back(&arg[0]);
+	}
+	argv.push_back(nullptr);
+
+	ostringstream out;
+	streambuf *cout_buffer = cout.rdbuf(out.rdbuf());
+	tests.Run(static_cast<int>(args.size()), argv.data());
+	cout.rdbuf(cout_buffer);
+
+	return out.str();
+}
+
+
+//! The tests (and their statuses) in brief output, in order.
+static vector<string> Reported(const string &output)
+{
+	const regex line("Running test '([^']*)'\\.\\.\\. ([a-z]+)");
+
+	vector<string> tests;
+	for (sregex_iterator i(output.begin(), output.end(), line), end;
+	     i != end; i++)
+	{
+		tests.push_back((*i)[1].str() + ": " + (*i)[2].str());
+	}
+
+	return tests;
+}
+
+
+int main(int, char*[])
+{
+	TestSuite tests;
+
+	tests.add(TestBuilder("A")
+		.description(" - fails")
+		.test([]() { Fail("A doesn't work"); })
+	);
+
+	tests.add(TestBuilder("B")
+		.description(" - passes")
+		.test([]() {})
+	);
+
+	tests.add(TestBuilder("C")
+		.description(" - is skipped because A fails")
+		.test([]() {})
+		.after("A")
+	);
+
+	const vector<string> expected = { "A: failed", "B: passed", "C: skipped" };
+
+	assert(Reported(Run(tests, { "--jobs=1" })) == expected);
+	assert(Reported(Run(tests, { "--jobs=4" })) == expected);
+	assert(Reported(Run(tests, { "--run-strategy=forkserver" }))
+	       == expected);
+
+	const string results = "/tmp/libgrading-order." + to_string(getpid());
+	{
+		ofstream(results) << Run(tests, { "--format=results" });
+	}
+
+	const vector<string> merged =
+		Reported(Run(tests, { "--merge=" + results }));
+	remove(results.c_str());
+
+	assert(merged == expected);
+
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*!
+ * @file      output.cpp
+ * @brief     Test output capture limits in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Run a test suite, noting each test's reported result (in verbose output).
+static map<string, string> Run(const TestSuite &tests, int argc, char *argv[],
+                               TestSuite::Statistics &stats)
+{
+	// Tests inherit cout's buffer: redirect the descriptor beneath it.
+	FILE *f = tmpfile();
+	assert(f != nullptr);
+
+	cout.flush();
+	const int stdout_fd = dup(STDOUT_FILENO);
+	dup2(fileno(f), STDOUT_FILENO);
+
+	stats = tests.Run(argc, argv);
+
+	cout.flush();
+	dup2(stdout_fd, STDOUT_FILENO);
+	close(stdout_fd);
+
+	ostringstream out;
+	rewind(f);
+	for (int c; (c = fgetc(f)) != EOF; )
+	{
+		out.put(static_cast<char>(c));
+	}
+	fclose(f);
+
+	cout << out.str();
+
+	const regex test("Running test: '([^']*)'\\.");
+	const regex result("Result: (.*)");
+
+	map<string, string> results;
+	istringstream lines(out.str());
+	string line, name;
+	smatch match;
+
+	while (getline(lines, line))
+	{
+		if (regex_match(line, match, test))
+			name = match[1];
+
+		else if (regex_match(line, match, result))
+			results[name] = match[1];
+	}
+
+	return results;
+}
+
+
+int main(int argc, char* argv[])
+{
+	TestSuite tests;
+
+	tests.add(TestBuilder("infinite output")
+		.description(" - should be killed by the suite's output limit")
+		.test([]()
+		{
+			while (true)
+			{
+				cout << "all work and no play makes Jack a dull boy\n";
+			}
+		})
+		.timeout(10)
+	);
+
+	tests.add(TestBuilder("per-test limit")
+		.description(" - should be killed by its own output limit")
+		.test([]()
+		{
+			cout << string(8192, 'x') << endl;
+		})
+		.outputLimit(4096)
+		.timeout(10)
+	);
+
+	tests.add(TestBuilder("lots of output")
+		.description(" - should pass, with only the head and tail kept")
+		.test([]()
+		{
+			cout << "head\n" << string(1 << 19, 'x') << "\ntail\n";
+		})
+		.timeout(10)
+	);
+
+	TestSuite::Statistics stats;
+	map<string, string> results = Run(tests, argc, argv, stats);
+
+	assert(stats.total == 3);
+	assert(stats.passed == 1);
+	assert(stats.failed == 2);
+
+	assert(results["infinite output"] == "output limit exceeded");
+	assert(results["per-test limit"] == "output limit exceeded");
+	assert(results["lots of output"] == "passed");
+
+	// Output can be read as strings or views, and copies share it.
+	const TestResult hello = TestBuilder("hello")
+		.test([]() { cout << "hello"; cerr << "world"; })
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	const TestResult copy(hello);
+	assert(hello.output == "hello" and hello.errorOutput == "world");
+	assert(copy.output.data() == hello.output.data());
+	assert(copy.outputView().str() == "hello");
+	assert(copy.errorOutputView().data() == hello.errorOutput.data());
+
+	return 0;
+}
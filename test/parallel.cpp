@@ -0,0 +1,91 @@
+/*!
+ * @file      parallel.cpp
+ * @brief     Test --jobs option for libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+const TestSuite tests =
+{
+	{
+		"slow pass",
+		" - finishes after the tests that follow it",
+		[]()
+		{
+			usleep(200000);
+			cout << "slow\n";
+		},
+	},
+
+	{
+		"fast pass",
+		" - finishes first, but should be reported second",
+		[]()
+		{
+			cout << "fast\n";
+		},
+	},
+
+	{
+		"fail",
+		" - fails a check",
+		[]()
+		{
+			CheckInt(1, 2);
+		},
+	},
+
+	{
+		"timeout",
+		" - should be killed after 1s",
+		[]()
+		{
+			while (true) {}
+		},
+		1
+	},
+
+	{
+		"segfault",
+		" - dereferences nullptr",
+		[]()
+		{
+			*static_cast<volatile double*>(nullptr);
+		},
+	},
+};
+
+
+int main(int argc, char* argv[])
+{
+	const TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 5);
+	assert(stats.passed == 2);
+	assert(stats.failed == 3);
+	assert(stats.supervisionTime.count() > 0);
+
+	return 0;
+}
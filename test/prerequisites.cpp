@@ -0,0 +1,112 @@
+/*!
+ * @file      prerequisites.cpp
+ * @brief     Test prerequisites (and skipped tests) in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+int main(int argc, char* argv[])
+{
+	// A file that one test creates and a test that runs after it reads.
+	const string marker = "/tmp/libgrading-prerequisites."
+		+ to_string(getpid());
+
+	TestSuite tests;
+
+	tests.add(TestBuilder("constructor")
+		.description(" - should fail")
+		.test([]() { Fail("constructor doesn't work"); })
+	);
+
+	tests.add(TestBuilder("uses constructor")
+		.description(" - should be skipped")
+		.test([]() { abort(); })
+		.after("constructor")
+	);
+
+	tests.add(TestBuilder("uses that")
+		.description(" - should be skipped (transitively)")
+		.test([]() { abort(); })
+		.after("uses constructor")
+	);
+
+	tests.add(TestBuilder("basic")
+		.description(" - should pass")
+		.test([]() {})
+		.tags({ "basic" })
+	);
+
+	tests.add(TestBuilder("advanced")
+		.description(" - should pass after all basic tests")
+		.test([]() {})
+		.afterTag("basic")
+	);
+
+	tests.add(TestBuilder("early dependent")
+		.description(" - should run after a test defined later")
+		.test([marker]()
+		{
+			FILE *f = fopen(marker.c_str(), "r");
+			CheckNonNull(f, "prerequisite's file");
+			fclose(f);
+			remove(marker.c_str());
+		})
+		.after("late prerequisite")
+	);
+
+	tests.add(TestBuilder("late prerequisite")
+		.description(" - should pass (and create a file)")
+		.test([marker]()
+		{
+			FILE *f = fopen(marker.c_str(), "w");
+			CheckNonNull(f, "fopen()");
+			fclose(f);
+		})
+	);
+
+	tests.add(TestBuilder("chicken")
+		.description(" - should be skipped (circular prerequisites)")
+		.test([]() { abort(); })
+		.after("egg")
+	);
+
+	tests.add(TestBuilder("egg")
+		.description(" - should be skipped (circular prerequisites)")
+		.test([]() { abort(); })
+		.after("chicken")
+	);
+
+	const TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 9);
+	assert(stats.passed == 4);
+	assert(stats.failed == 5);
+	assert(stats.skipped == 4);
+
+	return 0;
+}
@@ -0,0 +1,99 @@
+/*!
+ * @file      profile.cpp
+ * @brief     Test profiling of tests that time out in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <thread>
+
+using namespace grading;
+using namespace std;
+
+
+//! Spin forever (in a function that the profiler can name).
+void SpinForever()
+{
+	volatile unsigned long n = 0;
+	while (true)
+	{
+		n = n + 1;
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	const Timeout timeout = std::chrono::milliseconds(500);
+
+	TestSuite tests;
+
+	tests.add(TestBuilder("spinning")
+		.description(" - should time out, with a profile of SpinForever()")
+		.test(SpinForever)
+		.timeout(timeout)
+		.profile()
+	);
+
+	tests.add(TestBuilder("quick")
+		.description(" - passes (so no profile is reported)")
+		.test([]() {})
+		.profile()
+	);
+
+	TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 2 and stats.passed == 1);
+
+	// The test's hottest functions are reported after its error output.
+	const TestResult spinning = TestBuilder("spinning")
+		.test(SpinForever)
+		.timeout(timeout)
+		.profile()
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	const string errors = spinning.errorOutput;
+	assert(spinning.status == TestExitStatus::Timeout);
+	assert(errors.find("Profile of the test's stack (") != string::npos);
+	assert(errors.find("SpinForever()") != string::npos);
+
+	// A test that doesn't use any CPU time can't be sampled.
+	const TestResult sleeping = TestBuilder("sleeping")
+		.test([]() { std::this_thread::sleep_for(std::chrono::hours(1)); })
+		.timeout(timeout)
+		.profile()
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	assert(sleeping.status == TestExitStatus::Timeout);
+	assert(sleeping.errorOutput.find("no samples")
+	       != string::npos);
+
+	// Tests that aren't profiled don't report anything.
+	const TestResult unprofiled = TestBuilder("unprofiled")
+		.test(SpinForever)
+		.timeout(timeout)
+		.build()
+		.Run(TestRunStrategy::Separated);
+
+	assert(unprofiled.status == TestExitStatus::Timeout);
+	assert(unprofiled.errorOutput.empty());
+
+	return 0;
+}
@@ -0,0 +1,93 @@
+/*!
+ * @file      sandbox.cpp
+ * @brief     Test the Linux test sandbox in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <string>
+
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Identify the network namespace that this process is in (if any).
+static string NetworkNamespace()
+{
+	char name[64];
+	ssize_t len = readlink("/proc/self/ns/net", name, sizeof(name));
+
+	return (len > 0) ? string(name, static_cast<size_t>(len)) : "";
+}
+
+
+int main(int argc, char* argv[])
+{
+	TestSuite tests;
+
+	tests.add(TestBuilder("no sockets")
+		.description(" - creating a socket should be denied")
+		.test([]()
+		{
+			int sock = socket(AF_INET, SOCK_STREAM, 0);
+			Check(sock < 0 and errno == EPERM, "socket() denied");
+		})
+	);
+
+	tests.add(TestBuilder("no signalling the suite")
+		.description(" - signalling the test suite should be denied")
+		.test([]()
+		{
+			Check(kill(getppid(), 0) != 0, "kill() denied");
+		})
+	);
+
+	tests.add(TestBuilder("ordinary work")
+		.description(" - files, memory and child processes still work")
+		.test([]()
+		{
+			FILE *f = tmpfile();
+			CheckNonNull(f, "tmpfile()");
+			fclose(f);
+
+			pid_t child = fork();
+			if (child == 0)
+				_exit(0);
+
+			Check(child > 0, "fork()");
+		})
+	);
+
+	const string before = NetworkNamespace();
+
+	const TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 3);
+	assert(stats.passed == 3);
+
+	// Only the tests' processes are sandboxed, not the test suite's.
+	assert(NetworkNamespace() == before);
+
+	return 0;
+}
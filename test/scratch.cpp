@@ -0,0 +1,107 @@
+/*!
+ * @file      scratch.cpp
+ * @brief     Test per-test scratch directories in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include <dirent.h>
+#include <limits.h>
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Count the entries in the working directory (except "." and "..").
+static int CountEntries()
+{
+	DIR *dir = opendir(".");
+	CheckNonNull(dir, "opendir(\".\")");
+
+	int count = 0;
+	while (struct dirent *entry = readdir(dir))
+	{
+		if (strcmp(entry->d_name, ".") != 0
+		    and strcmp(entry->d_name, "..") != 0)
+		{
+			count++;
+		}
+	}
+
+	closedir(dir);
+	return count;
+}
+
+
+//! A test that expects an empty directory and then leaves a file in it.
+static void LeaveFile()
+{
+	CheckInt(0, CountEntries()) << "entries in fresh scratch directory";
+
+	FILE *f = fopen("left-behind", "w");
+	CheckNonNull(f, "fopen()");
+	fputs("hello\n", f);
+	fclose(f);
+
+	CheckInt(1, CountEntries()) << "entries after writing a file";
+}
+
+
+int main(int argc, char* argv[])
+{
+	char buffer[PATH_MAX];
+	assert(getcwd(buffer, sizeof(buffer)) != nullptr);
+	const string suiteDirectory = buffer;
+
+	TestSuite tests;
+
+	tests.add(TestBuilder("first scratch")
+		.description(" - should start in an empty directory")
+		.test(LeaveFile)
+		.scratchDirectory()
+	);
+
+	tests.add(TestBuilder("second scratch")
+		.description(" - shouldn't see the first test's file")
+		.test(LeaveFile)
+		.scratchDirectory()
+	);
+
+	tests.add(TestBuilder("not the suite's directory")
+		.description(" - should run somewhere other than the suite")
+		.test([suiteDirectory]()
+		{
+			char cwd[PATH_MAX];
+			CheckNonNull(getcwd(cwd, sizeof(cwd)), "getcwd()");
+			Check(suiteDirectory != cwd, "in a scratch directory");
+		})
+		.scratchDirectory()
+	);
+
+	const TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 3);
+	assert(stats.passed == 3);
+
+	return 0;
+}
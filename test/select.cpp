@@ -0,0 +1,77 @@
+/*!
+ * @file      select.cpp
+ * @brief     Test selection by name and tag in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdlib>
+
+using namespace grading;
+using namespace std;
+
+
+// This suite is meant to be run with:
+//   --name='list*' --tags=fast,core --exclude-tags=slow
+int main(int argc, char* argv[])
+{
+	TestSuite tests;
+
+	tests.add(TestBuilder("list: fast")
+		.description(" - should run")
+		.test([]() {})
+		.tags({ "fast" })
+	);
+
+	tests.add(TestBuilder("list: core")
+		.description(" - should run")
+		.test([]() {})
+		.tags({ "core", "list" })
+	);
+
+	tests.add(TestBuilder("list: core but slow")
+		.description(" - shouldn't run (excluded tag)")
+		.test([]() { abort(); })
+		.tags({ "core", "slow" })
+	);
+
+	tests.add(TestBuilder("list: untagged")
+		.description(" - shouldn't run (no selected tags)")
+		.test([]() { abort(); })
+	);
+
+	tests.add(TestBuilder("map: fast")
+		.description(" - shouldn't run (name doesn't match)")
+		.test([]() { abort(); })
+		.tags({ "fast" })
+	);
+
+	tests.add(TestBuilder("list: after map")
+		.description(" - should run (its prerequisite wasn't selected)")
+		.test([]() {})
+		.tags({ "fast" })
+		.after("map: fast")
+	);
+
+	const TestSuite::Statistics stats = tests.Run(argc, argv);
+	assert(stats.total == 3);
+	assert(stats.passed == 3);
+
+	return 0;
+}
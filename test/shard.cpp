@@ -0,0 +1,221 @@
+/*!
+ * @file      shard.cpp
+ * @brief     Test sharding and result merging in libgrading.
+ *
+ * @author    Jonathan Anderson <jonathan.anderson@mun.ca>
+ * @copyright (c) 2022 Jonathan Anderson. All rights reserved.
+ * @license   Apache License, Version 2.0
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License.  You may obtain a copy
+ * of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <libgrading.h>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace grading;
+using namespace std;
+
+
+//! Run a test suite with the given arguments (after argv[0]).
+static TestSuite::Statistics Run(const TestSuite &tests, const char *argv0,
+                                 vector<string> args)
+{
+	args.insert(args.begin(), argv0);
+
+	vector<char*> argv;
+	for (string &a : args)
+	{
+		argv.push_back(&a[0]);
+	}
+	argv.push_back(nullptr);
+
+	return tests.Run(static_cast<int>(args.size()), argv.data());
+}
+
+
+//! Run one shard of a test suite, saving its results to a file.
+static TestSuite::Statistics RunShard(const TestSuite &tests,
+                                      const char *argv0,
+                                      vector<string> args,
+                                      const string &filename)
+{
+	fflush(stdout);
+	cout.flush();
+
+	const int saved = dup(STDOUT_FILENO);
+	const int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC,
+	                    0600);
+	assert(saved >= 0 and fd >= 0);
+	dup2(fd, STDOUT_FILENO);
+	close(fd);
+
+	// The first --format wins: override whatever we were given.
+	args.insert(args.begin(), "--format=results");
+	const TestSuite::Statistics stats = Run(tests, argv0, args);
+
+	cout.flush();
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+
+	return stats;
+}
+
+
+int main(int argc, char* argv[])
+{
+	const string prefix = "/tmp/libgrading-shard." + to_string(getpid());
+	const string marker = prefix + ".setup";
+
+	TestSuite tests;
+
+	const unsigned int weights[] = { 5, 3, 3, 2, 2, 1, 1 };
+	for (unsigned int w : weights)
+	{
+		tests.add(TestBuilder("weight " + to_string(w))
+			.description(" - should pass")
+			.test([]() { cout << "hello from a shard\n"; })
+			.weight(w)
+		);
+	}
+
+	tests.add(TestBuilder("failure")
+		.description(" - should fail")
+		.test([]() { Fail("expected failure"); })
+	);
+
+	tests.add(TestBuilder("setup")
+		.description(" - should pass (and create a file)")
+		.test([marker]()
+		{
+			FILE *f = fopen(marker.c_str(), "w");
+			CheckNonNull(f, "fopen()");
+			fclose(f);
+		})
+	);
+
+	tests.add(TestBuilder("uses setup")
+		.description(" - should run in the same shard as 'setup'")
+		.test([marker]()
+		{
+			FILE *f = fopen(marker.c_str(), "r");
+			CheckNonNull(f, "setup's file");
+			fclose(f);
+			remove(marker.c_str());
+		})
+		.after("setup")
+	);
+
+	vector<string> args(argv + 1, argv + argc);
+
+	// Run each of three shards, saving their results.
+	unsigned int total = 0, passed = 0, firstPassed = 0;
+	string files;
+
+	for (int i = 1; i <= 3; i++)
+	{
+		const string filename = prefix + "." + to_string(i);
+
+		vector<string> shardArgs = args;
+		shardArgs.push_back("--shard=" + to_string(i) + "/3");
+
+		const TestSuite::Statistics s =
+			RunShard(tests, argv[0], shardArgs, filename);
+
+		assert(s.total > 0);
+		total += s.total;
+		passed += s.passed;
+
+		if (i == 1)
+			firstPassed = s.passed;
+
+		files += (files.empty() ? "" : ",") + filename;
+	}
+
+	// Every test should have run exactly once.
+	assert(total == 10);
+	assert(passed == 9);
+
+	// Merging the shards should look like running all tests at once.
+	vector<string> mergeArgs = args;
+	mergeArgs.push_back("--merge=" + files);
+
+	const TestSuite::Statistics stats = Run(tests, argv[0], mergeArgs);
+	assert(stats.total == 10);
+	assert(stats.passed == 9);
+	assert(stats.failed == 1);
+	assert(stats.score > 0.94f and stats.score < 0.96f);
+
+	// A shard's results that appear twice can't be trusted.
+	const string first = prefix + ".1";
+
+	mergeArgs = args;
+	mergeArgs.push_back("--merge=" + files + "," + first);
+
+	const TestSuite::Statistics twice = Run(tests, argv[0], mergeArgs);
+	assert(twice.total == 10);
+	assert(twice.passed == 9 - firstPassed);
+
+	// Nor can a result with an impossible status.
+	ifstream in(first);
+	string header, record;
+	getline(in, header);
+	getline(in, record);
+	in.close();
+
+	// Keep the record valid apart from its status (and without output).
+	istringstream fields(record);
+	vector<string> f{ istream_iterator<string>(fields),
+	                  istream_iterator<string>() };
+
+	f[f.size() - 2] = f[f.size() - 1] = "0";
+
+	const string hostile = prefix + ".hostile";
+	auto mergeWithStatus = [&](const string &status)
+	{
+		f[1] = status;
+
+		ofstream out(hostile);
+		out << header << "\n";
+		for (const string &field : f)
+		{
+			out << field << (&field == &f.back() ? "\n\n" : " ");
+		}
+		out.close();
+
+		vector<string> merge = args;
+		merge.push_back("--merge=" + hostile);
+
+		return Run(tests, argv[0], merge);
+	};
+
+	assert(mergeWithStatus("0").passed == 1);
+	assert(mergeWithStatus("99").passed == 0);
+
+	remove(hostile.c_str());
+
+	for (int i = 1; i <= 3; i++)
+	{
+		remove((prefix + "." + to_string(i)).c_str());
+	}
+
+	return 0;
+}
@@ -104,6 +104,17 @@ const TestSuite tests =
 		},
 		1
 	},
+
+	{
+		"should timeout quickly",
+		" - test times out\n"
+		" - the timeout should be interrupted after 250ms",
+		[]()
+		{
+			while (true) {}
+		},
+		Timeout(250)
+	},
 };
 
 